@@ -0,0 +1,7 @@
+/*
+ * Automatically generated by configure - do not modify
+ * Configured with: * './configure'
+ */
+#define CONFIG_HAVE_KERNEL_RWF_T
+#define CONFIG_HAVE_KERNEL_TIMESPEC
+#define CONFIG_HAVE_STATX
@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Startup time benchmark for giving N rings the same registered buffer
+ * pool, either by registering the pool on every ring, which pins and walks
+ * the pages each time, or by registering it once and cloning that table
+ * into the other rings with io_uring_clone_buffers().
+ *
+ * Pinning needs enough RLIMIT_MEMLOCK for the pool, or CAP_IPC_LOCK.
+ *
+ * gcc -Wall -O2 -D_GNU_SOURCE -o clone-buffers-bench clone-buffers-bench.c -luring
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "liburing.h"
+
+#define CHUNK_SIZE	(1024 * 1024)
+
+static const unsigned ring_counts[] = { 1, 16, 64 };
+static unsigned long pool_mb = 256;
+
+static struct iovec *iovs;
+static unsigned nr_iovs;
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int setup_pool(void)
+{
+	size_t size = pool_mb * 1024 * 1024;
+	char *pool;
+	unsigned i;
+
+	pool = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (pool == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	nr_iovs = size / CHUNK_SIZE;
+	iovs = calloc(nr_iovs, sizeof(*iovs));
+	if (!iovs)
+		return 1;
+	for (i = 0; i < nr_iovs; i++) {
+		iovs[i].iov_base = pool + (size_t) i * CHUNK_SIZE;
+		iovs[i].iov_len = CHUNK_SIZE;
+	}
+	return 0;
+}
+
+/*
+ * Give each of the 'nr' rings the pool, returning the time it took. The
+ * first ring always registers it, the rest clone from it if 'clone' is set.
+ */
+static int run(struct io_uring *rings, unsigned nr, int clone,
+	       unsigned long long *nsec)
+{
+	unsigned long long start;
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		ret = io_uring_queue_init(4, &rings[i], 0);
+		if (ret < 0) {
+			fprintf(stderr, "ring setup: %s\n", strerror(-ret));
+			return 1;
+		}
+	}
+
+	start = nsec_now();
+	for (i = 0; i < nr; i++) {
+		if (clone && i)
+			ret = io_uring_clone_buffers(&rings[i], &rings[0]);
+		else
+			ret = io_uring_register_buffers(&rings[i], iovs,
+							nr_iovs);
+		if (ret) {
+			fprintf(stderr, "%s: %s\n", clone && i ? "clone" :
+				"register", strerror(-ret));
+			return 1;
+		}
+	}
+	*nsec = nsec_now() - start;
+
+	for (i = 0; i < nr; i++)
+		io_uring_queue_exit(&rings[i]);
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s: [-s pool size in MB]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring *rings;
+	unsigned i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:h")) != -1) {
+		switch (opt) {
+		case 's':
+			pool_mb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!pool_mb) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (setup_pool())
+		return 1;
+	rings = calloc(ring_counts[2], sizeof(*rings));
+	if (!rings)
+		return 1;
+
+	for (i = 0; i < sizeof(ring_counts) / sizeof(ring_counts[0]); i++) {
+		unsigned long long reg_nsec, clone_nsec;
+
+		if (run(rings, ring_counts[i], 0, &reg_nsec) ||
+		    run(rings, ring_counts[i], 1, &clone_nsec))
+			return 1;
+		printf("%2u rings, %lu MB pool: register %8llu usec, "
+			"clone %8llu usec\n", ring_counts[i], pool_mb,
+			reg_nsec / 1000, clone_nsec / 1000);
+	}
+
+	return 0;
+}
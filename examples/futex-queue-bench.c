@@ -0,0 +1,329 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Handoff latency benchmark for a consumer thread that has to wait for both
+ * queue items from a producer thread and I/O completions on its ring. The
+ * producer alternates between pushing an item and writing to a pipe the
+ * consumer has a read posted on, and waits for each to be acked.
+ *
+ * futex:   the consumer arms IORING_OP_FUTEX_WAIT on the queue sequence
+ *          word, so a push is just another CQE, and the producer wakes it
+ *          with IORING_OP_FUTEX_WAKE from its own ring.
+ * condvar: the consumer sleeps on a pthread condition variable, and ring
+ *          completions reach it through io_uring_register_eventfd() and a
+ *          thread turning eventfd reads into condition signals.
+ *
+ * gcc -Wall -O2 -D_GNU_SOURCE -o futex-queue-bench futex-queue-bench.c -luring -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include "liburing.h"
+
+#ifndef FUTEX2_SIZE_U32
+#define FUTEX2_SIZE_U32		0x02
+#endif
+#ifndef FUTEX2_PRIVATE
+#define FUTEX2_PRIVATE		128
+#endif
+
+#define FUTEX_FLAGS	(FUTEX2_SIZE_U32 | FUTEX2_PRIVATE)
+
+enum {
+	MODE_FUTEX,
+	MODE_CONDVAR,
+	MODE_NR,
+};
+
+static const char *mode_names[MODE_NR] = { "futex", "condvar" };
+
+enum {
+	DATA_FUTEX = 1,
+	DATA_READ,
+};
+
+struct queue {
+	int mode;
+
+	/* futex word, bumped for every pushed item */
+	__u32 seq;
+	/* items and reads handled by the consumer so far */
+	unsigned consumed;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int io_ready;
+
+	struct io_uring cons_ring;
+	int pipe[2];
+	char pipe_buf;
+	int efd;
+	int stop;
+
+	pthread_barrier_t start;
+};
+
+static unsigned iterations = 100000;
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void arm_read(struct queue *q)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(&q->cons_ring);
+	io_uring_prep_read(sqe, q->pipe[0], &q->pipe_buf, 1, 0);
+	sqe->user_data = DATA_READ;
+}
+
+/*
+ * Reap the consumer ring, returning the number of reads completed, or -1
+ * on error. Reads are re-armed, a completed futex wait clears '*armed'.
+ */
+static int reap(struct queue *q, int *armed)
+{
+	struct io_uring_cqe *cqe;
+	int reads = 0;
+
+	while (!io_uring_peek_cqe(&q->cons_ring, &cqe)) {
+		if (cqe->user_data == DATA_READ) {
+			if (cqe->res != 1) {
+				fprintf(stderr, "pipe read: %d\n", cqe->res);
+				return -1;
+			}
+			arm_read(q);
+			reads++;
+		} else if (armed) {
+			*armed = 0;
+		}
+		io_uring_cqe_seen(&q->cons_ring, cqe);
+	}
+	return reads;
+}
+
+static int consume_futex(struct queue *q)
+{
+	struct io_uring_sqe *sqe;
+	unsigned done = 0, seen = 0, cur;
+	int armed = 0, ret;
+
+	while (done < iterations) {
+		if (!armed) {
+			sqe = io_uring_get_sqe(&q->cons_ring);
+			io_uring_prep_futex_wait(sqe, &q->seq, seen,
+						 FUTEX_BITSET_MATCH_ANY,
+						 FUTEX_FLAGS, 0);
+			sqe->user_data = DATA_FUTEX;
+			armed = 1;
+		}
+		ret = io_uring_submit_and_wait(&q->cons_ring, 1);
+		if (ret < 0) {
+			fprintf(stderr, "submit_and_wait: %s\n", strerror(-ret));
+			return 1;
+		}
+		ret = reap(q, &armed);
+		if (ret < 0)
+			return 1;
+		cur = __atomic_load_n(&q->seq, __ATOMIC_ACQUIRE);
+		done += ret + (cur - seen);
+		seen = cur;
+		__atomic_store_n(&q->consumed, done, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+static int consume_condvar(struct queue *q)
+{
+	unsigned done = 0, seen = 0, cur;
+	int io, ret;
+
+	while (done < iterations) {
+		pthread_mutex_lock(&q->lock);
+		while (q->seq == seen && !q->io_ready)
+			pthread_cond_wait(&q->cond, &q->lock);
+		cur = q->seq;
+		io = q->io_ready;
+		q->io_ready = 0;
+		pthread_mutex_unlock(&q->lock);
+
+		ret = 0;
+		if (io) {
+			ret = reap(q, NULL);
+			if (ret < 0)
+				return 1;
+			io_uring_submit(&q->cons_ring);
+		}
+		done += ret + (cur - seen);
+		seen = cur;
+		__atomic_store_n(&q->consumed, done, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+static void *consumer(void *data)
+{
+	struct queue *q = data;
+
+	pthread_barrier_wait(&q->start);
+	if (q->mode == MODE_FUTEX)
+		return (void *) (long) consume_futex(q);
+	return (void *) (long) consume_condvar(q);
+}
+
+/*
+ * Turns eventfd notifications of the consumer ring into condition signals
+ */
+static void *bridge(void *data)
+{
+	struct queue *q = data;
+	eventfd_t val;
+
+	while (!eventfd_read(q->efd, &val) &&
+	       !__atomic_load_n(&q->stop, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&q->lock);
+		q->io_ready = 1;
+		pthread_cond_signal(&q->cond);
+		pthread_mutex_unlock(&q->lock);
+	}
+	return NULL;
+}
+
+static void *producer(void *data)
+{
+	struct queue *q = data;
+	struct io_uring_sqe *sqe;
+	struct io_uring ring;
+	unsigned i;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret < 0) {
+		fprintf(stderr, "ring setup: %s\n", strerror(-ret));
+		exit(1);
+	}
+	pthread_barrier_wait(&q->start);
+
+	for (i = 0; i < iterations; i++) {
+		if (i & 1) {
+			if (write(q->pipe[1], "x", 1) != 1) {
+				perror("write");
+				exit(1);
+			}
+		} else if (q->mode == MODE_FUTEX) {
+			__atomic_add_fetch(&q->seq, 1, __ATOMIC_RELEASE);
+			sqe = io_uring_get_sqe(&ring);
+			io_uring_prep_futex_wake(sqe, &q->seq, 1,
+						 FUTEX_BITSET_MATCH_ANY,
+						 FUTEX_FLAGS, 0);
+			sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+			io_uring_submit(&ring);
+		} else {
+			pthread_mutex_lock(&q->lock);
+			q->seq++;
+			pthread_cond_signal(&q->cond);
+			pthread_mutex_unlock(&q->lock);
+		}
+		while (__atomic_load_n(&q->consumed, __ATOMIC_ACQUIRE) != i + 1)
+			;
+	}
+
+	io_uring_queue_exit(&ring);
+	return NULL;
+}
+
+static int run(int mode, unsigned long long *nsec)
+{
+	pthread_t cons, prod, br;
+	unsigned long long start;
+	struct queue q;
+	void *ret;
+
+	memset(&q, 0, sizeof(q));
+	q.mode = mode;
+	pthread_mutex_init(&q.lock, NULL);
+	pthread_cond_init(&q.cond, NULL);
+	pthread_barrier_init(&q.start, NULL, 3);
+
+	if (io_uring_queue_init(8, &q.cons_ring, 0) < 0 || pipe(q.pipe) < 0) {
+		fprintf(stderr, "setup failed\n");
+		return 1;
+	}
+	if (mode == MODE_CONDVAR) {
+		q.efd = eventfd(0, 0);
+		if (q.efd < 0 || io_uring_register_eventfd(&q.cons_ring, q.efd)) {
+			fprintf(stderr, "eventfd setup failed\n");
+			return 1;
+		}
+		pthread_create(&br, NULL, bridge, &q);
+	}
+	arm_read(&q);
+	io_uring_submit(&q.cons_ring);
+
+	/* all threads exist before the consumer arms a futex wait */
+	pthread_create(&cons, NULL, consumer, &q);
+	pthread_create(&prod, NULL, producer, &q);
+	pthread_barrier_wait(&q.start);
+	start = nsec_now();
+	pthread_join(prod, NULL);
+	*nsec = nsec_now() - start;
+	pthread_join(cons, &ret);
+
+	if (mode == MODE_CONDVAR) {
+		__atomic_store_n(&q.stop, 1, __ATOMIC_RELEASE);
+		eventfd_write(q.efd, 1);
+		pthread_join(br, NULL);
+		close(q.efd);
+	}
+	io_uring_queue_exit(&q.cons_ring);
+	close(q.pipe[0]);
+	close(q.pipe[1]);
+	return ret != NULL;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s: [-n iterations]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, mode;
+
+	while ((opt = getopt(argc, argv, "n:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (mode = 0; mode < MODE_NR; mode++) {
+		unsigned long long nsec;
+
+		if (run(mode, &nsec)) {
+			printf("%-8s: failed\n", mode_names[mode]);
+			continue;
+		}
+		printf("%-8s: %6llu nsec per handoff\n", mode_names[mode],
+			nsec / iterations);
+	}
+
+	return 0;
+}
@@ -77,20 +77,13 @@ static void queue_prepped(struct io_uring *ring, struct io_data *data)
 	io_uring_sqe_set_data(sqe, data);
 }
 
-static int queue_read(struct io_uring *ring, off_t size, off_t offset)
+static struct io_data *alloc_read(off_t size, off_t offset)
 {
-	struct io_uring_sqe *sqe;
 	struct io_data *data;
 
 	data = malloc(size + sizeof(*data));
 	if (!data)
-		return 1;
-
-	sqe = io_uring_get_sqe(ring);
-	if (!sqe) {
-		free(data);
-		return 1;
-	}
+		return NULL;
 
 	data->read = 1;
 	data->offset = data->first_offset = offset;
@@ -98,9 +91,29 @@ static int queue_read(struct io_uring *ring, off_t size, off_t offset)
 	data->iov.iov_base = data + 1;
 	data->iov.iov_len = size;
 	data->first_len = size;
+	return data;
+}
 
-	io_uring_prep_readv(sqe, infd, &data->iov, 1, offset);
-	io_uring_sqe_set_data(sqe, data);
+/*
+ * Reserve the sqes for a batch of reads in one go. The caller has made sure
+ * the SQ ring has room for them, so failing to get them is a bug.
+ */
+static int queue_reads(struct io_uring *ring, struct io_data **datas,
+		       unsigned nr)
+{
+	struct io_uring_sqe *sqes[QD];
+	unsigned i;
+
+	if (io_uring_get_sqes(ring, sqes, nr) != nr) {
+		fprintf(stderr, "io_uring_get_sqes: no room for %u sqes\n", nr);
+		return -1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		io_uring_prep_readv(sqes[i], infd, &datas[i]->iov, 1,
+					datas[i]->offset);
+		io_uring_sqe_set_data(sqes[i], datas[i]);
+	}
 	return 0;
 }
 
@@ -127,31 +140,32 @@ static int copy_file(struct io_uring *ring, off_t insize)
 	writes = reads = offset = 0;
 
 	while (insize || write_left) {
-		int had_reads, got_comp;
-	
+		struct io_data *datas[QD];
+		unsigned nr = 0;
+		int got_comp;
+
 		/*
 		 * Queue up as many reads as we can
 		 */
-		had_reads = reads;
-		while (insize) {
+		while (insize && reads + writes + nr < QD) {
 			off_t this_size = insize;
 
-			if (reads + writes >= QD)
-				break;
 			if (this_size > BS)
 				this_size = BS;
-			else if (!this_size)
-				break;
 
-			if (queue_read(ring, this_size, offset))
+			datas[nr] = alloc_read(this_size, offset);
+			if (!datas[nr])
 				break;
 
 			insize -= this_size;
 			offset += this_size;
-			reads++;
+			nr++;
 		}
 
-		if (had_reads != reads) {
+		if (nr) {
+			if (queue_reads(ring, datas, nr))
+				return 1;
+			reads += nr;
 			ret = io_uring_submit(ring);
 			if (ret < 0) {
 				fprintf(stderr, "io_uring_submit: %s\n", strerror(-ret));
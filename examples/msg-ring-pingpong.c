@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Ping-pong latency benchmark between two threads, each running its own
+ * ring, handing a message back and forth. Compares IORING_OP_MSG_RING
+ * through the sending ring, posting through io_uring_register_sync_msg(),
+ * and the eventfd wakeups that a ring-per-thread setup otherwise needs.
+ *
+ * gcc -Wall -O2 -D_GNU_SOURCE -o msg-ring-pingpong msg-ring-pingpong.c -luring -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "liburing.h"
+
+enum {
+	MODE_MSG_RING,
+	MODE_SYNC_MSG,
+	MODE_EVENTFD,
+	MODE_NR,
+};
+
+static const char *mode_names[MODE_NR] = { "msg_ring", "sync_msg", "eventfd" };
+
+struct side {
+	struct io_uring ring;
+	int efd;
+	struct side *peer;
+	int mode;
+	int ping;
+};
+
+static unsigned iterations = 100000;
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int send_msg(struct side *s, unsigned i)
+{
+	struct io_uring_sqe *sqe, sync_sqe;
+	eventfd_t val = 1;
+
+	switch (s->mode) {
+	case MODE_MSG_RING:
+		/* only the peer needs a CQE for this */
+		sqe = io_uring_get_sqe(&s->ring);
+		io_uring_prep_msg_ring(sqe, s->peer->ring.ring_fd, 0, i, 0);
+		sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+		return io_uring_submit(&s->ring) != 1;
+	case MODE_SYNC_MSG:
+		memset(&sync_sqe, 0, sizeof(sync_sqe));
+		io_uring_prep_msg_ring(&sync_sqe, s->peer->ring.ring_fd, 0, i,
+				       0);
+		return io_uring_register_sync_msg(&sync_sqe) != 0;
+	default:
+		return eventfd_write(s->peer->efd, val) != 0;
+	}
+}
+
+static int recv_msg(struct side *s, unsigned i)
+{
+	struct io_uring_cqe *cqe;
+	eventfd_t val;
+	int ret;
+
+	if (s->mode == MODE_EVENTFD)
+		return eventfd_read(s->efd, &val) != 0;
+
+	ret = io_uring_wait_cqe(&s->ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait: %s\n", strerror(-ret));
+		return 1;
+	}
+	if (cqe->res < 0 || cqe->user_data != i) {
+		fprintf(stderr, "bad message: res %d data %llu\n", cqe->res,
+			(unsigned long long) cqe->user_data);
+		return 1;
+	}
+	io_uring_cqe_seen(&s->ring, cqe);
+	return 0;
+}
+
+static void *run(void *data)
+{
+	struct side *s = data;
+	unsigned i;
+
+	for (i = 0; i < iterations; i++) {
+		if (s->ping && send_msg(s, i))
+			break;
+		if (recv_msg(s, i))
+			break;
+		if (!s->ping && send_msg(s, i))
+			break;
+	}
+	return (void *) (long) (i != iterations);
+}
+
+static int setup_side(struct side *s, struct side *peer, int mode, int ping)
+{
+	int ret;
+
+	ret = io_uring_queue_init(8, &s->ring, 0);
+	if (ret < 0) {
+		fprintf(stderr, "ring setup: %s\n", strerror(-ret));
+		return 1;
+	}
+	s->efd = eventfd(0, 0);
+	if (s->efd < 0) {
+		perror("eventfd");
+		return 1;
+	}
+	s->peer = peer;
+	s->mode = mode;
+	s->ping = ping;
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s: [-n iterations]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, mode;
+
+	while ((opt = getopt(argc, argv, "n:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (mode = 0; mode < MODE_NR; mode++) {
+		unsigned long long start, nsec;
+		struct side ping, pong;
+		void *ping_ret, *pong_ret;
+		pthread_t threads[2];
+
+		if (setup_side(&ping, &pong, mode, 1) ||
+		    setup_side(&pong, &ping, mode, 0))
+			return 1;
+
+		start = nsec_now();
+		pthread_create(&threads[1], NULL, run, &pong);
+		pthread_create(&threads[0], NULL, run, &ping);
+		pthread_join(threads[0], &ping_ret);
+		nsec = nsec_now() - start;
+
+		if (ping_ret) {
+			/* unstick the other side */
+			pthread_cancel(threads[1]);
+			pthread_join(threads[1], &pong_ret);
+			printf("%-8s: failed\n", mode_names[mode]);
+		} else {
+			pthread_join(threads[1], &pong_ret);
+			printf("%-8s: %6llu nsec round trip\n", mode_names[mode],
+				nsec / iterations);
+		}
+
+		io_uring_queue_exit(&ping.ring);
+		io_uring_queue_exit(&pong.ring);
+		close(ping.efd);
+		close(pong.efd);
+	}
+
+	return 0;
+}
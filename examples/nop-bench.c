@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Simple nop throughput benchmark, for measuring the overhead of the
+ * submission and completion paths.
+ *
+ * gcc -Wall -O2 -D_GNU_SOURCE -o nop-bench nop-bench.c -luring
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "liburing.h"
+
+static unsigned depth = 4096;
+static unsigned batch = 32;
+static unsigned runtime = 3;
+static int use_mem;
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int setup_ring(struct io_uring *ring)
+{
+	struct io_uring_params p;
+	int ret;
+
+	memset(&p, 0, sizeof(p));
+	if (use_mem) {
+		ret = io_uring_queue_init_mem(depth, ring, &p, NULL, 0);
+		if (ret >= 0 && !(ring->flags & IORING_SETUP_NO_MMAP))
+			fprintf(stderr, "ring memory not supported, using mmap\n");
+	} else {
+		ret = io_uring_queue_init_params(depth, ring, &p);
+	}
+	if (ret < 0) {
+		fprintf(stderr, "ring setup: %s\n", strerror(-ret));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int run(struct io_uring *ring, unsigned long long *done)
+{
+	unsigned long long end, nr = 0;
+	unsigned inflight = 0;
+
+	end = nsec_now() + runtime * 1000000000ULL;
+	do {
+		struct io_uring_cqe *cqe;
+		unsigned i, head, reaped;
+		int ret;
+
+		/* keep the ring full, in batches */
+		while (inflight + batch <= depth) {
+			for (i = 0; i < batch; i++)
+				io_uring_prep_nop(io_uring_get_sqe(ring));
+			inflight += batch;
+		}
+
+		ret = io_uring_submit_and_wait(ring, batch);
+		if (ret < 0) {
+			fprintf(stderr, "submit: %s\n", strerror(-ret));
+			return 1;
+		}
+
+		reaped = 0;
+		io_uring_for_each_cqe(ring, head, cqe)
+			reaped++;
+		io_uring_cq_advance(ring, reaped);
+		inflight -= reaped;
+		nr += reaped;
+	} while (nsec_now() < end);
+
+	*done = nr;
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s: [-d depth] [-b batch] [-t seconds] [-m]\n", argv0);
+	printf("\t-m\tuse io_uring_queue_init_mem() huge page ring memory\n");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long start, nr;
+	struct io_uring ring;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:t:mh")) != -1) {
+		switch (opt) {
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 't':
+			runtime = atoi(optarg);
+			break;
+		case 'm':
+			use_mem = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!batch || batch > depth) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (setup_ring(&ring))
+		return 1;
+
+	start = nsec_now();
+	if (run(&ring, &nr))
+		return 1;
+
+	printf("depth=%u batch=%u: %llu nops/sec\n", depth, batch,
+		nr * 1000000000ULL / (nsec_now() - start));
+	io_uring_queue_exit(&ring);
+	return 0;
+}
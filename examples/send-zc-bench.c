@@ -0,0 +1,293 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Loopback TCP send throughput benchmark, comparing copying sends with
+ * zero-copy sends for a range of payload sizes. A thread drains the
+ * receiving end with plain recv(2).
+ *
+ * Note that loopback delivery copies zero-copy payloads into the receiving
+ * socket anyway, so this mostly measures the submission side cost of the
+ * two. Use -r to send to a remote receiver (eg a netcat sink) instead.
+ *
+ * gcc -Wall -O2 -D_GNU_SOURCE -o send-zc-bench send-zc-bench.c -luring -lpthread
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "liburing.h"
+
+#define MIN_SIZE	4096
+#define MAX_SIZE	(1024 * 1024)
+
+enum {
+	MODE_COPY,
+	MODE_ZC,
+	MODE_ZC_FIXED,
+	MODE_NR,
+};
+
+static const char *mode_names[MODE_NR] = { "copy", "zc", "zc-fixed" };
+
+static unsigned depth = 8;
+static unsigned runtime = 1;
+static const char *remote;
+static int port = 8000;
+
+static char *bufs;
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *drain(void *data)
+{
+	int fd = (int) (long) data;
+	char *buf;
+
+	buf = malloc(MAX_SIZE);
+	while (recv(fd, buf, MAX_SIZE, 0) > 0)
+		;
+	free(buf);
+	close(fd);
+	return NULL;
+}
+
+/* connect to the remote sink, or to our own draining thread */
+static int connect_sink(pthread_t *thread)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int listen_fd, fd, rx_fd, val = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	/* zero-copy segments can't be coalesced, don't let Nagle hold them */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+
+	if (remote) {
+		addr.sin_port = htons(port);
+		if (inet_pton(AF_INET, remote, &addr.sin_addr) != 1) {
+			fprintf(stderr, "bad address %s\n", remote);
+			return -1;
+		}
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+			perror("connect");
+			return -1;
+		}
+		return fd;
+	}
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (listen_fd < 0 ||
+	    bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    listen(listen_fd, 1) < 0 ||
+	    getsockname(listen_fd, (struct sockaddr *) &addr, &addrlen) < 0) {
+		perror("listen");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("connect");
+		return -1;
+	}
+	rx_fd = accept(listen_fd, NULL, NULL);
+	if (rx_fd < 0) {
+		perror("accept");
+		return -1;
+	}
+	close(listen_fd);
+	pthread_create(thread, NULL, drain, (void *) (long) rx_fd);
+	return fd;
+}
+
+static void prep_send(struct io_uring *ring, int fd, int mode, unsigned slot,
+		      unsigned size)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+	char *buf = bufs + (size_t) slot * MAX_SIZE;
+
+	switch (mode) {
+	case MODE_COPY:
+		io_uring_prep_send(sqe, fd, buf, size, MSG_WAITALL);
+		break;
+	case MODE_ZC:
+		io_uring_prep_send_zc(sqe, fd, buf, size, MSG_WAITALL, 0);
+		break;
+	case MODE_ZC_FIXED:
+		io_uring_prep_send_zc_fixed(sqe, fd, buf, size, MSG_WAITALL,
+					    0, slot);
+		break;
+	}
+	sqe->user_data = slot;
+}
+
+/*
+ * Keep 'depth' sends in flight for 'runtime' seconds. A buffer slot is only
+ * reused once its send is done with it, which for zero-copy sends is the
+ * notification CQE rather than the send result.
+ */
+static int run(struct io_uring *ring, int fd, int mode, unsigned size,
+	       unsigned long long *bytes)
+{
+	unsigned long long end, nr = 0;
+	unsigned free_slots[depth];
+	unsigned nr_free = 0, inflight = 0, i;
+	int ret;
+
+	for (i = 0; i < depth; i++)
+		free_slots[nr_free++] = i;
+
+	end = nsec_now() + runtime * 1000000000ULL;
+	do {
+		struct io_uring_cqe *cqe;
+		unsigned head, reaped = 0;
+
+		while (nr_free) {
+			prep_send(ring, fd, mode, free_slots[--nr_free], size);
+			inflight++;
+		}
+
+		ret = io_uring_submit_and_wait(ring, 1);
+		if (ret < 0) {
+			fprintf(stderr, "submit: %s\n", strerror(-ret));
+			return 1;
+		}
+
+		io_uring_for_each_cqe(ring, head, cqe) {
+			reaped++;
+			if (cqe->res < 0) {
+				fprintf(stderr, "send: %s\n",
+					strerror(-cqe->res));
+				return 1;
+			}
+			if (!io_uring_cqe_notif(cqe))
+				nr += cqe->res;
+			if (io_uring_send_zc_buf_done(cqe)) {
+				free_slots[nr_free++] = cqe->user_data;
+				inflight--;
+			}
+		}
+		io_uring_cq_advance(ring, reaped);
+	} while (nsec_now() < end);
+
+	/* wait for the buffers of the remaining sends to be released */
+	while (inflight) {
+		struct io_uring_cqe *cqe;
+
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait: %s\n", strerror(-ret));
+			return 1;
+		}
+		if (io_uring_send_zc_buf_done(cqe))
+			inflight--;
+		io_uring_cqe_seen(ring, cqe);
+	}
+
+	*bytes = nr;
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s: [-d depth] [-t seconds] [-r address] [-p port]\n", argv0);
+	printf("\t-r\tsend to a remote sink rather than a loopback thread\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	struct iovec *iovs;
+	unsigned size, i;
+	int opt, ret, mode;
+
+	while ((opt = getopt(argc, argv, "d:t:r:p:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 't':
+			runtime = atoi(optarg);
+			break;
+		case 'r':
+			remote = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!depth) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	/* each slot holds a result and a notification cqe in flight */
+	ret = io_uring_queue_init(2 * depth, &ring, 0);
+	if (ret < 0) {
+		fprintf(stderr, "ring setup: %s\n", strerror(-ret));
+		return 1;
+	}
+
+	bufs = malloc((size_t) depth * MAX_SIZE);
+	iovs = calloc(depth, sizeof(*iovs));
+	if (!bufs || !iovs)
+		return 1;
+	memset(bufs, 0x5a, (size_t) depth * MAX_SIZE);
+	for (i = 0; i < depth; i++) {
+		iovs[i].iov_base = bufs + (size_t) i * MAX_SIZE;
+		iovs[i].iov_len = MAX_SIZE;
+	}
+	ret = io_uring_register_buffers(&ring, iovs, depth);
+	if (ret) {
+		fprintf(stderr, "register buffers: %s\n", strerror(-ret));
+		return 1;
+	}
+
+	for (size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+		for (mode = 0; mode < MODE_NR; mode++) {
+			unsigned long long start, bytes, nsec;
+			pthread_t thread;
+			int fd;
+
+			fd = connect_sink(&thread);
+			if (fd < 0)
+				return 1;
+
+			start = nsec_now();
+			if (run(&ring, fd, mode, size, &bytes))
+				return 1;
+			nsec = nsec_now() - start;
+
+			printf("size=%7u %-8s: %8llu MB/s\n", size,
+				mode_names[mode], bytes * 1000 / nsec);
+
+			shutdown(fd, SHUT_RDWR);
+			close(fd);
+			if (!remote)
+				pthread_join(thread, NULL);
+		}
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
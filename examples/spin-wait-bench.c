@@ -0,0 +1,259 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Round trip latency benchmark for a TCP ping-pong over loopback between
+ * two threads, each running its own ring and waiting for its receives with
+ * io_uring_wait_cqe(). Compares sleeping in the kernel straight away with
+ * spinning on the CQ ring first, as set up by io_uring_set_spin_wait().
+ *
+ * gcc -Wall -O2 -D_GNU_SOURCE -o spin-wait-bench spin-wait-bench.c -luring -lpthread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "liburing.h"
+
+#define MSG_SIZE	64
+
+enum {
+	MODE_SLEEP,
+	MODE_SPIN,
+	MODE_ADAPTIVE,
+	MODE_YIELD,
+	MODE_NR,
+};
+
+static const char *mode_names[MODE_NR] = {
+	"sleep", "spin", "adaptive", "yield"
+};
+
+static const unsigned mode_flags[MODE_NR] = {
+	0, 0, LIBURING_SPIN_ADAPTIVE, LIBURING_SPIN_YIELD
+};
+
+struct side {
+	struct io_uring ring;
+	int fd;
+	char buf[MSG_SIZE];
+};
+
+static unsigned iterations = 100000;
+static unsigned spin_usec = 50;
+static int mode;
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int setup_side(struct side *s)
+{
+	int ret;
+
+	ret = io_uring_queue_init(8, &s->ring, 0);
+	if (ret < 0) {
+		fprintf(stderr, "ring setup: %s\n", strerror(-ret));
+		return 1;
+	}
+	if (mode != MODE_SLEEP) {
+		ret = io_uring_set_spin_wait(&s->ring, spin_usec,
+						mode_flags[mode]);
+		if (ret < 0) {
+			fprintf(stderr, "set spin wait: %s\n", strerror(-ret));
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Queue a send of our message, which only posts a CQE if it fails, and a
+ * receive of the reply
+ */
+static void queue_send_recv(struct side *s)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(&s->ring);
+	io_uring_prep_send(sqe, s->fd, s->buf, MSG_SIZE, 0);
+	sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = 1;
+
+	sqe = io_uring_get_sqe(&s->ring);
+	io_uring_prep_recv(sqe, s->fd, s->buf, MSG_SIZE, MSG_WAITALL);
+	sqe->user_data = 2;
+}
+
+static int wait_recv(struct side *s)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	ret = io_uring_wait_cqe(&s->ring, &cqe);
+	if (ret < 0) {
+		fprintf(stderr, "wait: %s\n", strerror(-ret));
+		return 1;
+	}
+	if (cqe->user_data != 2 || cqe->res != MSG_SIZE) {
+		fprintf(stderr, "%s: %d\n", cqe->user_data == 2 ? "recv" :
+			"send", cqe->res);
+		return 1;
+	}
+	io_uring_cqe_seen(&s->ring, cqe);
+	return 0;
+}
+
+static void *echo(void *data)
+{
+	struct side *s = data;
+	struct io_uring_sqe *sqe;
+	unsigned i;
+
+	sqe = io_uring_get_sqe(&s->ring);
+	io_uring_prep_recv(sqe, s->fd, s->buf, MSG_SIZE, MSG_WAITALL);
+	sqe->user_data = 2;
+	io_uring_submit(&s->ring);
+
+	for (i = 0; i < iterations; i++) {
+		if (wait_recv(s))
+			return (void *) 1;
+		if (i + 1 < iterations) {
+			queue_send_recv(s);
+		} else {
+			sqe = io_uring_get_sqe(&s->ring);
+			io_uring_prep_send(sqe, s->fd, s->buf, MSG_SIZE, 0);
+		}
+		io_uring_submit(&s->ring);
+	}
+	return NULL;
+}
+
+static int cmp_nsec(const void *p1, const void *p2)
+{
+	unsigned long long a = *(const unsigned long long *) p1;
+	unsigned long long b = *(const unsigned long long *) p2;
+
+	return a < b ? -1 : a > b;
+}
+
+static int run(int *fds, unsigned long long *lat)
+{
+	struct side ping, pong;
+	unsigned long long start;
+	pthread_t thread;
+	unsigned i;
+	void *ret;
+
+	memset(&ping, 0, sizeof(ping));
+	memset(&pong, 0, sizeof(pong));
+	ping.fd = fds[0];
+	pong.fd = fds[1];
+	if (setup_side(&ping) || setup_side(&pong))
+		return 1;
+
+	pthread_create(&thread, NULL, echo, &pong);
+	for (i = 0; i < iterations; i++) {
+		start = nsec_now();
+		queue_send_recv(&ping);
+		io_uring_submit(&ping.ring);
+		if (wait_recv(&ping))
+			return 1;
+		lat[i] = nsec_now() - start;
+	}
+	pthread_join(thread, &ret);
+
+	io_uring_queue_exit(&ping.ring);
+	io_uring_queue_exit(&pong.ring);
+	return ret != NULL;
+}
+
+static int connect_loopback(int *fds)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int lfd, val = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(lfd, 1) ||
+	    getsockname(lfd, (struct sockaddr *) &addr, &len)) {
+		perror("listen");
+		return 1;
+	}
+	fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+	if (fds[0] < 0 ||
+	    connect(fds[0], (struct sockaddr *) &addr, sizeof(addr))) {
+		perror("connect");
+		return 1;
+	}
+	fds[1] = accept(lfd, NULL, NULL);
+	if (fds[1] < 0) {
+		perror("accept");
+		return 1;
+	}
+	close(lfd);
+
+	setsockopt(fds[0], IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+	setsockopt(fds[1], IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	printf("%s: [-n iterations] [-s spin usec]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long *lat;
+	int opt, fds[2];
+
+	while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 's':
+			spin_usec = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	lat = calloc(iterations, sizeof(*lat));
+	if (!lat || connect_loopback(fds))
+		return 1;
+
+	for (mode = 0; mode < MODE_NR; mode++) {
+		if (run(fds, lat)) {
+			printf("%-8s: failed\n", mode_names[mode]);
+			return 1;
+		}
+		qsort(lat, iterations, sizeof(*lat), cmp_nsec);
+		printf("%-8s: p50 %6llu nsec, p99 %6llu nsec\n", mode_names[mode],
+			lat[iterations / 2], lat[iterations * 99ULL / 100]);
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
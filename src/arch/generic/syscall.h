@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: MIT */
+#ifndef LIBURING_ARCH_GENERIC_SYSCALL_H
+#define LIBURING_ARCH_GENERIC_SYSCALL_H
+
+#include <errno.h>
+#include <unistd.h>
+
+/*
+ * Everything else goes through libc's syscall(), turning its -1 and errno
+ * into the -errno the raw versions return
+ */
+static inline long __do_syscall2(long nr, long a1, long a2)
+{
+	long ret = syscall(nr, a1, a2);
+
+	return ret < 0 ? -errno : ret;
+}
+
+static inline long __do_syscall4(long nr, long a1, long a2, long a3,
+				 long a4)
+{
+	long ret = syscall(nr, a1, a2, a3, a4);
+
+	return ret < 0 ? -errno : ret;
+}
+
+static inline long __do_syscall6(long nr, long a1, long a2, long a3,
+				 long a4, long a5, long a6)
+{
+	long ret = syscall(nr, a1, a2, a3, a4, a5, a6);
+
+	return ret < 0 ? -errno : ret;
+}
+
+#endif
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: MIT */
+#ifndef LIBURING_ARCH_X86_SYSCALL_H
+#define LIBURING_ARCH_X86_SYSCALL_H
+
+/*
+ * x86-64 system calls, straight through the syscall instruction. The
+ * kernel returns -errno in %rax, and clobbers %rcx and %r11.
+ */
+static inline long __do_syscall2(long nr, long a1, long a2)
+{
+	long ret;
+
+	__asm__ volatile ("syscall"
+		: "=a" (ret)
+		: "a" (nr), "D" (a1), "S" (a2)
+		: "rcx", "r11", "memory");
+	return ret;
+}
+
+static inline long __do_syscall4(long nr, long a1, long a2, long a3,
+				 long a4)
+{
+	register long r10 __asm__("r10") = a4;
+	long ret;
+
+	__asm__ volatile ("syscall"
+		: "=a" (ret)
+		: "a" (nr), "D" (a1), "S" (a2), "d" (a3), "r" (r10)
+		: "rcx", "r11", "memory");
+	return ret;
+}
+
+static inline long __do_syscall6(long nr, long a1, long a2, long a3,
+				 long a4, long a5, long a6)
+{
+	register long r10 __asm__("r10") = a4;
+	register long r8 __asm__("r8") = a5;
+	register long r9 __asm__("r9") = a6;
+	long ret;
+
+	__asm__ volatile ("syscall"
+		: "=a" (ret)
+		: "a" (nr), "D" (a1), "S" (a2), "d" (a3), "r" (r10),
+		  "r" (r8), "r" (r9)
+		: "rcx", "r11", "memory");
+	return ret;
+}
+
+#endif
@@ -12,6 +12,7 @@ extern "C" {
 #include <signal.h>
 #include <inttypes.h>
 #include <time.h>
+#include <endian.h>
 #include "liburing/compat.h"
 #include "liburing/io_uring.h"
 #include "liburing/barrier.h"
@@ -26,7 +27,7 @@ struct io_uring_sq {
 	unsigned *kring_entries;
 	unsigned *kflags;
 	unsigned *kdropped;
-	unsigned *array;
+	unsigned *array;	/* NULL with IORING_SETUP_NO_SQARRAY */
 	struct io_uring_sqe *sqes;
 
 	unsigned sqe_head;
@@ -34,6 +35,13 @@ struct io_uring_sq {
 
 	size_t ring_sz;
 	void *ring_ptr;
+
+	/*
+	 * Copies of *kring_mask and *kring_entries, which never change once
+	 * the ring is setup, so the fast paths stay out of shared memory
+	 */
+	unsigned ring_mask;
+	unsigned ring_entries;
 };
 
 struct io_uring_cq {
@@ -46,6 +54,10 @@ struct io_uring_cq {
 
 	size_t ring_sz;
 	void *ring_ptr;
+
+	/* see struct io_uring_sq */
+	unsigned ring_mask;
+	unsigned ring_entries;
 };
 
 struct io_uring {
@@ -53,6 +65,22 @@ struct io_uring {
 	struct io_uring_cq cq;
 	unsigned flags;
 	int ring_fd;
+	unsigned features;
+	int enter_ring_fd;
+	__u8 int_flags;
+	/*
+	 * log2 of the SQE and CQE size in units of the base structs, 1 for
+	 * IORING_SETUP_SQE128 and IORING_SETUP_CQE32 rings, 0 otherwise
+	 */
+	__u8 sqe_shift;
+	__u8 cqe_shift;
+	__u8 pad;
+	unsigned pad2;
+
+	/* see io_uring_set_spin_wait() */
+	unsigned spin_nsec;
+	unsigned spin_flags;
+	unsigned spin_avg_nsec;
 };
 
 /*
@@ -78,27 +106,77 @@ extern int io_uring_queue_init_params(unsigned entries, struct io_uring *ring,
 	struct io_uring_params *p);
 extern int io_uring_queue_init(unsigned entries, struct io_uring *ring,
 	unsigned flags);
+extern int io_uring_queue_init_single_issuer(unsigned entries,
+	struct io_uring *ring, unsigned flags);
+extern int io_uring_queue_init_mem(unsigned entries, struct io_uring *ring,
+	struct io_uring_params *p, void *buf, size_t buf_size);
 extern int io_uring_queue_mmap(int fd, struct io_uring_params *p,
 	struct io_uring *ring);
 extern int io_uring_ring_dontfork(struct io_uring *ring);
 extern void io_uring_queue_exit(struct io_uring *ring);
 unsigned io_uring_peek_batch_cqe(struct io_uring *ring,
 	struct io_uring_cqe **cqes, unsigned count);
+extern unsigned io_uring_copy_cqes(struct io_uring *ring,
+	struct io_uring_cqe *cqes, unsigned count);
+typedef void (*io_uring_cqe_fn)(struct io_uring *ring,
+	struct io_uring_cqe *cqe, void *data);
+extern unsigned io_uring_dispatch_cqes(struct io_uring *ring,
+	io_uring_cqe_fn fn, void *data, unsigned count);
 extern int io_uring_wait_cqes(struct io_uring *ring,
 	struct io_uring_cqe **cqe_ptr, unsigned wait_nr,
 	struct __kernel_timespec *ts, sigset_t *sigmask);
+extern int io_uring_wait_cqes_min_timeout(struct io_uring *ring,
+	struct io_uring_cqe **cqe_ptr, unsigned wait_nr,
+	struct __kernel_timespec *ts, unsigned int min_wait_usec,
+	sigset_t *sigmask);
 extern int io_uring_wait_cqe_timeout(struct io_uring *ring,
 	struct io_uring_cqe **cqe_ptr, struct __kernel_timespec *ts);
 extern int io_uring_submit(struct io_uring *ring);
 extern int io_uring_submit_and_wait(struct io_uring *ring, unsigned wait_nr);
-extern struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring);
+extern int io_uring_get_events(struct io_uring *ring);
+extern unsigned io_uring_get_sqes(struct io_uring *ring,
+	struct io_uring_sqe **sqes, unsigned count);
+
+/*
+ * Flags for io_uring_set_spin_wait()
+ *
+ * LIBURING_SPIN_ADAPTIVE	Size the spin from how long recent waits took,
+ *				rather than always spinning for the full budget
+ * LIBURING_SPIN_YIELD		Yield the CPU between checks of the CQ ring,
+ *				rather than just hinting to it that we're
+ *				spinning. For when the completing side may
+ *				need the CPU we're spinning on.
+ */
+#define LIBURING_SPIN_ADAPTIVE	(1U << 0)
+#define LIBURING_SPIN_YIELD	(1U << 1)
+
+extern int io_uring_set_spin_wait(struct io_uring *ring, unsigned spin_usec,
+	unsigned flags);
 
 extern int io_uring_register_buffers(struct io_uring *ring,
 					const struct iovec *iovecs,
 					unsigned nr_iovecs);
+extern int io_uring_register_buffers_tags(struct io_uring *ring,
+					  const struct iovec *iovecs,
+					  const __u64 *tags, unsigned nr);
+extern int io_uring_register_buffers_sparse(struct io_uring *ring,
+					    unsigned nr);
+extern int io_uring_register_buffers_update_tag(struct io_uring *ring,
+						unsigned off,
+						const struct iovec *iovecs,
+						const __u64 *tags, unsigned nr);
+extern int io_uring_clone_buffers(struct io_uring *dst, struct io_uring *src);
+extern int io_uring_clone_buffers_offset(struct io_uring *dst,
+					 struct io_uring *src,
+					 unsigned dst_off, unsigned src_off,
+					 unsigned nr, unsigned flags);
 extern int io_uring_unregister_buffers(struct io_uring *ring);
 extern int io_uring_register_files(struct io_uring *ring, const int *files,
 					unsigned nr_files);
+extern int io_uring_register_files_sparse(struct io_uring *ring,
+					  unsigned nr_files);
+extern int io_uring_register_file_alloc_range(struct io_uring *ring,
+					      unsigned off, unsigned len);
 extern int io_uring_unregister_files(struct io_uring *ring);
 extern int io_uring_register_files_update(struct io_uring *ring, unsigned off,
 					int *files, unsigned nr_files);
@@ -109,6 +187,30 @@ extern int io_uring_register_probe(struct io_uring *ring,
 					struct io_uring_probe *p, unsigned nr);
 extern int io_uring_register_personality(struct io_uring *ring);
 extern int io_uring_unregister_personality(struct io_uring *ring, int id);
+extern int io_uring_register_ring_fd(struct io_uring *ring);
+extern int io_uring_unregister_ring_fd(struct io_uring *ring);
+extern int io_uring_register_buf_ring(struct io_uring *ring,
+				      struct io_uring_buf_reg *reg,
+				      unsigned int flags);
+extern int io_uring_unregister_buf_ring(struct io_uring *ring, int bgid);
+
+/*
+ * Issue an IORING_OP_MSG_RING data sqe directly, without going through a
+ * ring of our own. Returns 0 once the CQE has been posted to the target.
+ */
+extern int io_uring_register_sync_msg(struct io_uring_sqe *sqe);
+
+/*
+ * Allocate and register a ring of 'nentries' provided buffers for buffer
+ * group 'bgid'. Returns the ring, or NULL with the error in 'ret'.
+ */
+extern struct io_uring_buf_ring *io_uring_setup_buf_ring(struct io_uring *ring,
+						unsigned int nentries,
+						int bgid, unsigned int flags,
+						int *ret);
+extern int io_uring_free_buf_ring(struct io_uring *ring,
+				  struct io_uring_buf_ring *br,
+				  unsigned int nentries, int bgid);
 
 /*
  * Helper for the peek/wait single cqe functions. Exported because of that,
@@ -127,7 +229,8 @@ extern int __io_uring_get_cqe(struct io_uring *ring,
 	 */								\
 	for (head = *(ring)->cq.khead;					\
 	     (cqe = (head != io_uring_smp_load_acquire((ring)->cq.ktail) ? \
-		&(ring)->cq.cqes[head & (*(ring)->cq.kring_mask)] : NULL)); \
+		&(ring)->cq.cqes[(head & (ring)->cq.ring_mask)		\
+				 << (ring)->cqe_shift] : NULL));	\
 	     head++)							\
 
 /*
@@ -171,6 +274,38 @@ static inline void *io_uring_cqe_get_data(const struct io_uring_cqe *cqe)
 	return (void *) (uintptr_t) cqe->user_data;
 }
 
+/*
+ * Returns non-zero if the request that posted this cqe will post more, zero
+ * if this was its final completion. For multishot requests, the latter means
+ * the request has terminated and must be re-armed.
+ */
+static inline int io_uring_cqe_more(const struct io_uring_cqe *cqe)
+{
+	return (cqe->flags & IORING_CQE_F_MORE) != 0;
+}
+
+/*
+ * Zero-copy sends post two CQEs. The first carries the send result, and has
+ * IORING_CQE_F_MORE set if a notification CQE follows, with the same
+ * user_data and IORING_CQE_F_NOTIF set, once the kernel no longer references
+ * the data. If the first CQE has no IORING_CQE_F_MORE, no notification will
+ * be posted.
+ */
+static inline int io_uring_cqe_notif(const struct io_uring_cqe *cqe)
+{
+	return (cqe->flags & IORING_CQE_F_NOTIF) != 0;
+}
+
+/*
+ * Returns non-zero if this cqe ends the lifecycle of a zero-copy send, and
+ * the buffer it sent from may be reused. That is either the notification
+ * CQE, or a send result CQE that no notification will follow.
+ */
+static inline int io_uring_send_zc_buf_done(const struct io_uring_cqe *cqe)
+{
+	return !io_uring_cqe_more(cqe);
+}
+
 static inline void io_uring_sqe_set_flags(struct io_uring_sqe *sqe,
 					  unsigned flags)
 {
@@ -190,7 +325,24 @@ static inline void io_uring_prep_rw(int op, struct io_uring_sqe *sqe, int fd,
 	sqe->len = len;
 	sqe->rw_flags = 0;
 	sqe->user_data = 0;
-	sqe->__pad2[0] = sqe->__pad2[1] = sqe->__pad2[2] = 0;
+	sqe->buf_index = 0;
+	sqe->personality = 0;
+	sqe->splice_fd_in = 0;
+	sqe->addr3 = 0;
+	sqe->__pad2[0] = 0;
+}
+
+/*
+ * Set the registered file slot a request installs its new file into, rather
+ * than the normal file table. Slots are passed to the kernel offset by 1,
+ * as 0 means no slot, but IORING_FILE_INDEX_ALLOC is passed as is.
+ */
+static inline void __io_uring_set_target_fixed_file(struct io_uring_sqe *sqe,
+						    unsigned int file_index)
+{
+	if (file_index != IORING_FILE_INDEX_ALLOC)
+		file_index++;
+	sqe->file_index = file_index;
 }
 
 static inline void io_uring_prep_splice(struct io_uring_sqe *sqe,
@@ -220,6 +372,21 @@ static inline void io_uring_prep_read_fixed(struct io_uring_sqe *sqe, int fd,
 	sqe->buf_index = buf_index;
 }
 
+/*
+ * Vectored read into registered buffer 'buf_index'. Every iovec must lie
+ * within that buffer, the kernel fails the request with -EFAULT otherwise.
+ */
+static inline void io_uring_prep_readv_fixed(struct io_uring_sqe *sqe, int fd,
+					     const struct iovec *iovecs,
+					     unsigned nr_vecs, off_t offset,
+					     int flags, int buf_index)
+{
+	io_uring_prep_rw(IORING_OP_READV_FIXED, sqe, fd, iovecs, nr_vecs,
+				offset);
+	sqe->rw_flags = flags;
+	sqe->buf_index = buf_index;
+}
+
 static inline void io_uring_prep_writev(struct io_uring_sqe *sqe, int fd,
 					const struct iovec *iovecs,
 					unsigned nr_vecs, off_t offset)
@@ -235,6 +402,21 @@ static inline void io_uring_prep_write_fixed(struct io_uring_sqe *sqe, int fd,
 	sqe->buf_index = buf_index;
 }
 
+/*
+ * Vectored write from registered buffer 'buf_index', with the same rules as
+ * io_uring_prep_readv_fixed()
+ */
+static inline void io_uring_prep_writev_fixed(struct io_uring_sqe *sqe, int fd,
+					      const struct iovec *iovecs,
+					      unsigned nr_vecs, off_t offset,
+					      int flags, int buf_index)
+{
+	io_uring_prep_rw(IORING_OP_WRITEV_FIXED, sqe, fd, iovecs, nr_vecs,
+				offset);
+	sqe->rw_flags = flags;
+	sqe->buf_index = buf_index;
+}
+
 static inline void io_uring_prep_recvmsg(struct io_uring_sqe *sqe, int fd,
 					 struct msghdr *msg, unsigned flags)
 {
@@ -242,6 +424,97 @@ static inline void io_uring_prep_recvmsg(struct io_uring_sqe *sqe, int fd,
 	sqe->msg_flags = flags;
 }
 
+/*
+ * Multishot recvmsg keeps posting a CQE per received message, each in its
+ * own selected buffer, until it errors or is cancelled. Only the
+ * msg_namelen and msg_controllen fields of 'msg' are used, and the buffer
+ * is laid out as a struct io_uring_recvmsg_out followed by the name,
+ * control data and payload. Use the io_uring_recvmsg_*() helpers to find
+ * them.
+ */
+static inline void io_uring_prep_recvmsg_multishot(struct io_uring_sqe *sqe,
+						   int fd, struct msghdr *msg,
+						   unsigned flags)
+{
+	io_uring_prep_recvmsg(sqe, fd, msg, flags);
+	sqe->ioprio |= IORING_RECV_MULTISHOT;
+}
+
+/*
+ * Returns the header of a buffer filled by a multishot recvmsg, or NULL if
+ * the buffer of 'buf_len' bytes (cqe->res) is too small to hold the header,
+ * name and control data that 'msgh' asked for.
+ */
+static inline struct io_uring_recvmsg_out *
+io_uring_recvmsg_validate(void *buf, int buf_len, struct msghdr *msgh)
+{
+	unsigned long header = msgh->msg_controllen + msgh->msg_namelen +
+				sizeof(struct io_uring_recvmsg_out);
+
+	if (buf_len < 0 || (unsigned long) buf_len < header)
+		return NULL;
+	return (struct io_uring_recvmsg_out *) buf;
+}
+
+static inline void *io_uring_recvmsg_name(struct io_uring_recvmsg_out *o)
+{
+	return (void *) &o[1];
+}
+
+static inline struct cmsghdr *
+io_uring_recvmsg_cmsg_firsthdr(struct io_uring_recvmsg_out *o,
+			       struct msghdr *msgh)
+{
+	if (o->controllen < sizeof(struct cmsghdr))
+		return NULL;
+
+	return (struct cmsghdr *) ((unsigned char *) io_uring_recvmsg_name(o) +
+			msgh->msg_namelen);
+}
+
+static inline struct cmsghdr *
+io_uring_recvmsg_cmsg_nexthdr(struct io_uring_recvmsg_out *o,
+			      struct msghdr *msgh, struct cmsghdr *cmsg)
+{
+	unsigned char *end;
+
+	if (cmsg->cmsg_len < sizeof(struct cmsghdr))
+		return NULL;
+	end = (unsigned char *) io_uring_recvmsg_cmsg_firsthdr(o, msgh) +
+		o->controllen;
+	cmsg = (struct cmsghdr *) ((unsigned char *) cmsg +
+			CMSG_ALIGN(cmsg->cmsg_len));
+
+	if ((unsigned char *) (cmsg + 1) > end)
+		return NULL;
+	if (((unsigned char *) cmsg) + CMSG_ALIGN(cmsg->cmsg_len) > end)
+		return NULL;
+
+	return cmsg;
+}
+
+static inline void *io_uring_recvmsg_payload(struct io_uring_recvmsg_out *o,
+					     struct msghdr *msgh)
+{
+	return (void *) ((unsigned char *) io_uring_recvmsg_name(o) +
+			msgh->msg_namelen + msgh->msg_controllen);
+}
+
+/*
+ * Length of the payload in a buffer of 'buf_len' bytes, which may be less
+ * than o->payloadlen if the message was truncated
+ */
+static inline unsigned int
+io_uring_recvmsg_payload_length(struct io_uring_recvmsg_out *o,
+				int buf_len, struct msghdr *msgh)
+{
+	unsigned long payload_start, payload_end;
+
+	payload_start = (unsigned long) io_uring_recvmsg_payload(o, msgh);
+	payload_end = (unsigned long) o + buf_len;
+	return (unsigned int) (payload_end - payload_start);
+}
+
 static inline void io_uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd,
 					 const struct msghdr *msg, unsigned flags)
 {
@@ -249,11 +522,49 @@ static inline void io_uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd,
 	sqe->msg_flags = flags;
 }
 
+/*
+ * Like io_uring_prep_sendmsg(), but sends without copying the data. The
+ * buffers must stay untouched until the notification CQE, see
+ * io_uring_send_zc_buf_done().
+ */
+static inline void io_uring_prep_sendmsg_zc(struct io_uring_sqe *sqe, int fd,
+					    const struct msghdr *msg,
+					    unsigned flags)
+{
+	io_uring_prep_sendmsg(sqe, fd, msg, flags);
+	sqe->opcode = IORING_OP_SENDMSG_ZC;
+}
+
+/*
+ * The kernel reads the full 32-bit poll mask as two swapped 16-bit halves on
+ * big endian, so that the low half still lines up with the old 16-bit
+ * sqe->poll_events field.
+ */
+static inline unsigned __io_uring_prep_poll_mask(unsigned poll_mask)
+{
+#if __BYTE_ORDER == __BIG_ENDIAN
+	poll_mask = (poll_mask << 16) | (poll_mask >> 16);
+#endif
+	return poll_mask;
+}
+
 static inline void io_uring_prep_poll_add(struct io_uring_sqe *sqe, int fd,
-					  short poll_mask)
+					  unsigned poll_mask)
 {
 	io_uring_prep_rw(IORING_OP_POLL_ADD, sqe, fd, NULL, 0, 0);
-	sqe->poll_events = poll_mask;
+	sqe->poll32_events = __io_uring_prep_poll_mask(poll_mask);
+}
+
+/*
+ * Multishot poll stays armed after it triggers, and posts a CQE with
+ * IORING_CQE_F_MORE set every time the file becomes ready. The last CQE
+ * won't have IORING_CQE_F_MORE set, and the poll must then be re-armed.
+ */
+static inline void io_uring_prep_poll_multishot(struct io_uring_sqe *sqe,
+						int fd, unsigned poll_mask)
+{
+	io_uring_prep_poll_add(sqe, fd, poll_mask);
+	sqe->len = IORING_POLL_ADD_MULTI;
 }
 
 static inline void io_uring_prep_poll_remove(struct io_uring_sqe *sqe,
@@ -262,6 +573,23 @@ static inline void io_uring_prep_poll_remove(struct io_uring_sqe *sqe,
 	io_uring_prep_rw(IORING_OP_POLL_REMOVE, sqe, -1, user_data, 0, 0);
 }
 
+/*
+ * Update the armed poll request matching 'old_user_data' in place. 'flags'
+ * is a mask of IORING_POLL_UPDATE_EVENTS, to replace its events with
+ * 'poll_mask', and IORING_POLL_UPDATE_USER_DATA, to replace its user_data
+ * with 'new_user_data'. IORING_POLL_ADD_MULTI may be passed too, to change
+ * the request to or from multishot along with its events.
+ */
+static inline void io_uring_prep_poll_update(struct io_uring_sqe *sqe,
+					     void *old_user_data,
+					     void *new_user_data,
+					     unsigned poll_mask, unsigned flags)
+{
+	io_uring_prep_rw(IORING_OP_POLL_REMOVE, sqe, -1, old_user_data, flags,
+			 (__u64) (uintptr_t) new_user_data);
+	sqe->poll32_events = __io_uring_prep_poll_mask(poll_mask);
+}
+
 static inline void io_uring_prep_fsync(struct io_uring_sqe *sqe, int fd,
 				       unsigned fsync_flags)
 {
@@ -299,6 +627,49 @@ static inline void io_uring_prep_accept(struct io_uring_sqe *sqe, int fd,
 	sqe->accept_flags = flags;
 }
 
+/*
+ * Accept into registered file slot 'file_index', or a free slot if that is
+ * IORING_FILE_INDEX_ALLOC, rather than the normal file table. cqe->res is 0,
+ * or the slot picked for IORING_FILE_INDEX_ALLOC.
+ */
+static inline void io_uring_prep_accept_direct(struct io_uring_sqe *sqe, int fd,
+					       struct sockaddr *addr,
+					       socklen_t *addrlen, int flags,
+					       unsigned int file_index)
+{
+	io_uring_prep_accept(sqe, fd, addr, addrlen, flags);
+	__io_uring_set_target_fixed_file(sqe, file_index);
+}
+
+/*
+ * Multishot accept keeps posting a CQE for every new connection, with
+ * IORING_CQE_F_MORE set, until it errors or is cancelled. The last CQE
+ * won't have IORING_CQE_F_MORE set, and the request must then be re-armed
+ * if more connections are wanted.
+ */
+static inline void io_uring_prep_multishot_accept(struct io_uring_sqe *sqe,
+						  int fd, struct sockaddr *addr,
+						  socklen_t *addrlen, int flags)
+{
+	io_uring_prep_accept(sqe, fd, addr, addrlen, flags);
+	sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+}
+
+/*
+ * Like io_uring_prep_multishot_accept(), but installs each accepted socket
+ * into a free slot in the registered file table rather than the normal
+ * file table. cqe->res is the slot used, or -ENFILE once the table is full.
+ */
+static inline void io_uring_prep_multishot_accept_direct(struct io_uring_sqe *sqe,
+							 int fd,
+							 struct sockaddr *addr,
+							 socklen_t *addrlen,
+							 int flags)
+{
+	io_uring_prep_multishot_accept(sqe, fd, addr, addrlen, flags);
+	sqe->file_index = IORING_FILE_INDEX_ALLOC;
+}
+
 static inline void io_uring_prep_cancel(struct io_uring_sqe *sqe, void *user_data,
 					int flags)
 {
@@ -306,6 +677,60 @@ static inline void io_uring_prep_cancel(struct io_uring_sqe *sqe, void *user_dat
 	sqe->cancel_flags = flags;
 }
 
+/*
+ * Post a CQE to the ring 'fd', with 'len' as the cqe->res and 'data' as the
+ * cqe->user_data. The submitting ring gets its own CQE for the request.
+ */
+static inline void io_uring_prep_msg_ring(struct io_uring_sqe *sqe, int fd,
+					  unsigned int len, __u64 data,
+					  unsigned int flags)
+{
+	io_uring_prep_rw(IORING_OP_MSG_RING, sqe, fd, NULL, len, data);
+	sqe->msg_ring_flags = flags;
+}
+
+/*
+ * Like io_uring_prep_msg_ring(), but also sets 'cqe_flags' as the
+ * cqe->flags of the posted CQE
+ */
+static inline void io_uring_prep_msg_ring_cqe_flags(struct io_uring_sqe *sqe,
+						    int fd, unsigned int len,
+						    __u64 data,
+						    unsigned int flags,
+						    unsigned int cqe_flags)
+{
+	io_uring_prep_msg_ring(sqe, fd, len, data,
+			       IORING_MSG_RING_FLAGS_PASS | flags);
+	sqe->file_index = cqe_flags;
+}
+
+/*
+ * Install the registered file 'source_fd' of the submitting ring into slot
+ * 'target_fd' of the registered file table of ring 'fd', and post a CQE
+ * there with 'data' as the cqe->user_data, unless IORING_MSG_RING_CQE_SKIP
+ * is set in 'flags'. 'target_fd' may be IORING_FILE_INDEX_ALLOC to pick a
+ * free slot, which cqe->res of both the source and target CQE then holds.
+ */
+static inline void io_uring_prep_msg_ring_fd(struct io_uring_sqe *sqe, int fd,
+					     int source_fd, int target_fd,
+					     __u64 data, unsigned int flags)
+{
+	io_uring_prep_rw(IORING_OP_MSG_RING, sqe, fd,
+			 (void *) (uintptr_t) IORING_MSG_SEND_FD, 0, data);
+	sqe->addr3 = source_fd;
+	__io_uring_set_target_fixed_file(sqe, target_fd);
+	sqe->msg_ring_flags = flags;
+}
+
+static inline void io_uring_prep_msg_ring_fd_alloc(struct io_uring_sqe *sqe,
+						   int fd, int source_fd,
+						   __u64 data,
+						   unsigned int flags)
+{
+	io_uring_prep_msg_ring_fd(sqe, fd, source_fd, IORING_FILE_INDEX_ALLOC,
+				  data, flags);
+}
+
 static inline void io_uring_prep_link_timeout(struct io_uring_sqe *sqe,
 					      struct __kernel_timespec *ts,
 					      unsigned flags)
@@ -343,17 +768,60 @@ static inline void io_uring_prep_openat(struct io_uring_sqe *sqe, int dfd,
 	sqe->open_flags = flags;
 }
 
+/*
+ * Like io_uring_prep_openat(), but opens into registered file slot
+ * 'file_index', or a free slot if that is IORING_FILE_INDEX_ALLOC. The file
+ * is then only usable with IOSQE_FIXED_FILE. cqe->res is 0, or the slot
+ * picked for IORING_FILE_INDEX_ALLOC.
+ */
+static inline void io_uring_prep_openat_direct(struct io_uring_sqe *sqe,
+					       int dfd, const char *path,
+					       int flags, mode_t mode,
+					       unsigned file_index)
+{
+	io_uring_prep_openat(sqe, dfd, path, flags, mode);
+	__io_uring_set_target_fixed_file(sqe, file_index);
+}
+
 static inline void io_uring_prep_close(struct io_uring_sqe *sqe, int fd)
 {
 	io_uring_prep_rw(IORING_OP_CLOSE, sqe, fd, NULL, 0, 0);
 }
 
+/*
+ * Close registered file slot 'file_index', leaving it free for reuse
+ */
+static inline void io_uring_prep_close_direct(struct io_uring_sqe *sqe,
+					      unsigned file_index)
+{
+	io_uring_prep_close(sqe, 0);
+	__io_uring_set_target_fixed_file(sqe, file_index);
+}
+
 static inline void io_uring_prep_read(struct io_uring_sqe *sqe, int fd,
 				      void *buf, unsigned nbytes, off_t offset)
 {
 	io_uring_prep_rw(IORING_OP_READ, sqe, fd, buf, nbytes, offset);
 }
 
+/*
+ * Prepare 'nr' sqes, eg from io_uring_get_sqes(), to read the consecutive
+ * 'nbytes' sized blocks of 'fd' starting at 'offset' into the consecutive
+ * blocks of 'buf'. The user_data of each is left to the caller.
+ */
+static inline void io_uring_prep_read_many(struct io_uring_sqe **sqes,
+					   unsigned nr, int fd, void *buf,
+					   unsigned nbytes, off_t offset)
+{
+	unsigned i;
+
+	for (i = 0; i < nr; i++) {
+		io_uring_prep_read(sqes[i], fd, (char *) buf + (size_t) i * nbytes,
+					nbytes, offset);
+		offset += nbytes;
+	}
+}
+
 static inline void io_uring_prep_write(struct io_uring_sqe *sqe, int fd,
 				       const void *buf, unsigned nbytes, off_t offset)
 {
@@ -391,6 +859,60 @@ static inline void io_uring_prep_send(struct io_uring_sqe *sqe, int sockfd,
 	sqe->msg_flags = flags;
 }
 
+/*
+ * Bundle send, which sends the data of as many buffers of the provided
+ * buffer group as are available in one go, up to 'len' bytes if 'len' isn't
+ * 0. Must be used with IOSQE_BUFFER_SELECT. The buffers are consumed from
+ * the buffer ring, see io_uring_buf_ring_bundle_nr() to find how many.
+ */
+static inline void io_uring_prep_send_bundle(struct io_uring_sqe *sqe,
+					     int sockfd, size_t len, int flags)
+{
+	io_uring_prep_send(sqe, sockfd, NULL, len, flags);
+	sqe->ioprio |= IORING_RECVSEND_BUNDLE;
+}
+
+/*
+ * Like io_uring_prep_send(), but sends without copying the data. 'zc_flags'
+ * may hold IORING_SEND_ZC_REPORT_USAGE. The buffer must stay untouched until
+ * the notification CQE, see io_uring_send_zc_buf_done().
+ */
+static inline void io_uring_prep_send_zc(struct io_uring_sqe *sqe, int sockfd,
+					 const void *buf, size_t len, int flags,
+					 unsigned zc_flags)
+{
+	io_uring_prep_rw(IORING_OP_SEND_ZC, sqe, sockfd, buf, len, 0);
+	sqe->msg_flags = flags;
+	sqe->ioprio = zc_flags;
+}
+
+/*
+ * Zero-copy send from registered buffer 'buf_index', which saves pinning
+ * the pages for every send. 'buf' must lie within that buffer.
+ */
+static inline void io_uring_prep_send_zc_fixed(struct io_uring_sqe *sqe,
+					       int sockfd, const void *buf,
+					       size_t len, int flags,
+					       unsigned zc_flags,
+					       unsigned buf_index)
+{
+	io_uring_prep_send_zc(sqe, sockfd, buf, len, flags, zc_flags);
+	sqe->ioprio |= IORING_RECVSEND_FIXED_BUF;
+	sqe->buf_index = buf_index;
+}
+
+/*
+ * Set the destination address of a send_zc request, for unconnected
+ * sockets
+ */
+static inline void io_uring_prep_send_set_addr(struct io_uring_sqe *sqe,
+					       const struct sockaddr *dest_addr,
+					       __u16 addr_len)
+{
+	sqe->addr2 = (unsigned long) (const void *) dest_addr;
+	sqe->addr_len = addr_len;
+}
+
 static inline void io_uring_prep_recv(struct io_uring_sqe *sqe, int sockfd,
 				      void *buf, size_t len, int flags)
 {
@@ -398,6 +920,32 @@ static inline void io_uring_prep_recv(struct io_uring_sqe *sqe, int sockfd,
 	sqe->msg_flags = flags;
 }
 
+/*
+ * Multishot recv keeps posting a CQE per receive, each in its own selected
+ * buffer, until it errors or is cancelled. Must be used with
+ * IOSQE_BUFFER_SELECT, 'buf' is ignored and 'len' may be 0 to use the full
+ * size of the selected buffer.
+ */
+static inline void io_uring_prep_recv_multishot(struct io_uring_sqe *sqe,
+						int sockfd, void *buf,
+						size_t len, int flags)
+{
+	io_uring_prep_recv(sqe, sockfd, buf, len, flags);
+	sqe->ioprio |= IORING_RECV_MULTISHOT;
+}
+
+/*
+ * Bundle recv, which may fill several buffers of the provided buffer group
+ * rather than just one, up to 'len' bytes if 'len' isn't 0. Must be used
+ * with IOSQE_BUFFER_SELECT. May be combined with IORING_RECV_MULTISHOT.
+ */
+static inline void io_uring_prep_recv_bundle(struct io_uring_sqe *sqe,
+					     int sockfd, size_t len, int flags)
+{
+	io_uring_prep_recv(sqe, sockfd, NULL, len, flags);
+	sqe->ioprio |= IORING_RECVSEND_BUNDLE;
+}
+
 static inline void io_uring_prep_openat2(struct io_uring_sqe *sqe, int dfd,
 					const char *path, struct open_how *how)
 {
@@ -405,6 +953,46 @@ static inline void io_uring_prep_openat2(struct io_uring_sqe *sqe, int dfd,
 				(uint64_t) (uintptr_t) how);
 }
 
+static inline void io_uring_prep_openat2_direct(struct io_uring_sqe *sqe,
+						int dfd, const char *path,
+						struct open_how *how,
+						unsigned file_index)
+{
+	io_uring_prep_openat2(sqe, dfd, path, how);
+	__io_uring_set_target_fixed_file(sqe, file_index);
+}
+
+static inline void io_uring_prep_socket(struct io_uring_sqe *sqe, int domain,
+					int type, int protocol,
+					unsigned int flags)
+{
+	io_uring_prep_rw(IORING_OP_SOCKET, sqe, domain, NULL, protocol, type);
+	sqe->rw_flags = flags;
+}
+
+/*
+ * Like io_uring_prep_socket(), but creates the socket in registered file
+ * slot 'file_index', or a free slot if that is IORING_FILE_INDEX_ALLOC
+ */
+static inline void io_uring_prep_socket_direct(struct io_uring_sqe *sqe,
+					       int domain, int type,
+					       int protocol,
+					       unsigned file_index,
+					       unsigned int flags)
+{
+	io_uring_prep_socket(sqe, domain, type, protocol, flags);
+	__io_uring_set_target_fixed_file(sqe, file_index);
+}
+
+static inline void io_uring_prep_socket_direct_alloc(struct io_uring_sqe *sqe,
+						     int domain, int type,
+						     int protocol,
+						     unsigned int flags)
+{
+	io_uring_prep_socket_direct(sqe, domain, type, protocol,
+				    IORING_FILE_INDEX_ALLOC, flags);
+}
+
 struct epoll_event;
 static inline void io_uring_prep_epoll_ctl(struct io_uring_sqe *sqe, int epfd,
 					   int fd, int op,
@@ -428,6 +1016,143 @@ static inline void io_uring_prep_remove_buffers(struct io_uring_sqe *sqe,
 	sqe->buf_group = bgid;
 }
 
+/*
+ * Wait on 'futex' while it holds 'val', as futex_wait(2). 'futex_flags' are
+ * the FUTEX2_* size and private flags, 'flags' is for the request itself and
+ * must be 0 for now. The CQE is posted once the futex is woken, with -EAGAIN
+ * right away if the value didn't match.
+ */
+static inline void io_uring_prep_futex_wait(struct io_uring_sqe *sqe,
+					    __u32 *futex, __u64 val,
+					    __u64 mask, __u32 futex_flags,
+					    unsigned int flags)
+{
+	io_uring_prep_rw(IORING_OP_FUTEX_WAIT, sqe, futex_flags, futex, 0, val);
+	sqe->futex_flags = flags;
+	sqe->addr3 = mask;
+}
+
+/*
+ * Wake up to 'val' waiters on 'futex', as futex_wake(2). The CQE res is
+ * the number of waiters woken.
+ */
+static inline void io_uring_prep_futex_wake(struct io_uring_sqe *sqe,
+					    __u32 *futex, __u64 val,
+					    __u64 mask, __u32 futex_flags,
+					    unsigned int flags)
+{
+	io_uring_prep_rw(IORING_OP_FUTEX_WAKE, sqe, futex_flags, futex, 0, val);
+	sqe->futex_flags = flags;
+	sqe->addr3 = mask;
+}
+
+struct futex_waitv;
+
+/*
+ * Wait on any of the 'nr_futex' futexes in 'futex', as futex_waitv(2). The
+ * CQE res is the index of the futex that was woken.
+ */
+static inline void io_uring_prep_futex_waitv(struct io_uring_sqe *sqe,
+					     struct futex_waitv *futex,
+					     __u32 nr_futex,
+					     unsigned int flags)
+{
+	io_uring_prep_rw(IORING_OP_FUTEX_WAITV, sqe, 0, futex, nr_futex, 0);
+	sqe->futex_flags = flags;
+}
+
+/*
+ * Initialise a provided buffer ring, before it is registered
+ */
+static inline void io_uring_buf_ring_init(struct io_uring_buf_ring *br)
+{
+	br->tail = 0;
+}
+
+/*
+ * Calculate the mask to pass to io_uring_buf_ring_add() for a buffer ring
+ * of 'ring_entries' entries
+ */
+static inline int io_uring_buf_ring_mask(__u32 ring_entries)
+{
+	return ring_entries - 1;
+}
+
+/*
+ * Add a buffer to a provided buffer ring. 'buf_offset' is the number of
+ * buffers already added since the last io_uring_buf_ring_advance(). The
+ * kernel doesn't see the buffer until the ring is advanced.
+ */
+static inline void io_uring_buf_ring_add(struct io_uring_buf_ring *br,
+					 void *addr, unsigned int len,
+					 unsigned short bid, int mask,
+					 int buf_offset)
+{
+	struct io_uring_buf *buf = &br->bufs[(br->tail + buf_offset) & mask];
+
+	buf->addr = (unsigned long) (uintptr_t) addr;
+	buf->len = len;
+	buf->bid = bid;
+}
+
+/*
+ * Make 'count' new buffers visible to the kernel. Called after
+ * io_uring_buf_ring_add() has been called 'count' times to fill in new
+ * buffers.
+ */
+static inline void io_uring_buf_ring_advance(struct io_uring_buf_ring *br,
+					     int count)
+{
+	unsigned short new_tail = br->tail + count;
+
+	io_uring_smp_store_release(&br->tail, new_tail);
+}
+
+/*
+ * Make 'count' new buffers visible to the kernel while at the same time
+ * marking 'count' CQEs as seen, for the common case of recycling the
+ * buffers of the completions just handled.
+ */
+static inline void io_uring_buf_ring_cq_advance(struct io_uring *ring,
+						struct io_uring_buf_ring *br,
+						int count)
+{
+	io_uring_buf_ring_advance(br, count);
+	io_uring_cq_advance(ring, count);
+}
+
+/*
+ * Return the buffer at ring index 'idx' of a provided buffer ring
+ */
+static inline struct io_uring_buf *
+io_uring_buf_ring_entry(struct io_uring_buf_ring *br, int mask,
+			unsigned short idx)
+{
+	return &br->bufs[idx & mask];
+}
+
+/*
+ * A bundle send or recv of 'len' bytes (cqe->res) consumes contiguous buffers
+ * of the ring, starting at the index 'head' holding the buffer ID reported
+ * in the cqe. Returns how many buffers that is, the last of which may only
+ * be partially used. Zero length buffers within the bundle count as used.
+ * Buffer i of the bundle is at index 'head + i', see
+ * io_uring_buf_ring_entry(). Never returns more than the ring size.
+ */
+static inline unsigned io_uring_buf_ring_bundle_nr(struct io_uring_buf_ring *br,
+						   int mask,
+						   unsigned short head,
+						   int len)
+{
+	unsigned nr = 0;
+
+	while (len > 0 && nr <= (unsigned) mask) {
+		len -= io_uring_buf_ring_entry(br, mask, head + nr)->len;
+		nr++;
+	}
+	return nr;
+}
+
 static inline unsigned io_uring_sq_ready(struct io_uring *ring)
 {
 	/* always use real head, to avoid losing sync for short submit */
@@ -436,37 +1161,69 @@ static inline unsigned io_uring_sq_ready(struct io_uring *ring)
 
 static inline unsigned io_uring_sq_space_left(struct io_uring *ring)
 {
-	return *ring->sq.kring_entries - io_uring_sq_ready(ring);
+	return ring->sq.ring_entries - io_uring_sq_ready(ring);
 }
 
+/*
+ * Returns non-zero if the kernel has flagged that task work is pending for
+ * this ring, which must run before the completions it holds are posted.
+ * Only ever set for rings setup with IORING_SETUP_TASKRUN_FLAG. The peek,
+ * wait, copy and dispatch functions run it, otherwise use
+ * io_uring_get_events().
+ */
+static inline int io_uring_cq_needs_flush(struct io_uring *ring)
+{
+	return (IO_URING_READ_ONCE(*ring->sq.kflags) & IORING_SQ_TASKRUN) != 0;
+}
+
+/*
+ * Returns the number of completions in the CQ ring. Never enters the kernel,
+ * so completions still held in pending task work aren't counted, see
+ * io_uring_cq_needs_flush().
+ */
 static inline unsigned io_uring_cq_ready(struct io_uring *ring)
 {
 	return io_uring_smp_load_acquire(ring->cq.ktail) - *ring->cq.khead;
 }
 
-static int __io_uring_peek_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr)
+static inline int __io_uring_peek_cqe(struct io_uring *ring,
+				      struct io_uring_cqe **cqe_ptr,
+				      unsigned *nr_available)
 {
 	struct io_uring_cqe *cqe;
-	unsigned head;
+	unsigned available;
+	unsigned mask = ring->cq.ring_mask;
 	int err = 0;
 
 	do {
-		io_uring_for_each_cqe(ring, head, cqe)
+		unsigned tail = io_uring_smp_load_acquire(ring->cq.ktail);
+		unsigned head = *ring->cq.khead;
+
+		cqe = NULL;
+		available = tail - head;
+		if (!available)
 			break;
-		if (cqe) {
-			if (cqe->user_data == LIBURING_UDATA_TIMEOUT) {
-				if (cqe->res < 0)
-					err = cqe->res;
-				io_uring_cq_advance(ring, 1);
-				if (!err)
-					continue;
-				cqe = NULL;
-			}
+
+		cqe = &ring->cq.cqes[(head & mask) << ring->cqe_shift];
+		/*
+		 * Internal timeouts are only posted on kernels that lack
+		 * IORING_FEAT_EXT_ARG, see io_uring_wait_cqes()
+		 */
+		if (!(ring->features & IORING_FEAT_EXT_ARG) &&
+		    cqe->user_data == LIBURING_UDATA_TIMEOUT) {
+			if (cqe->res < 0)
+				err = cqe->res;
+			io_uring_cq_advance(ring, 1);
+			if (!err)
+				continue;
+			cqe = NULL;
 		}
 		break;
 	} while (1);
 
 	*cqe_ptr = cqe;
+	if (nr_available)
+		*nr_available = available;
 	return err;
 }
 
@@ -481,7 +1238,7 @@ static inline int io_uring_wait_cqe_nr(struct io_uring *ring,
 {
 	int err;
 
-	err = __io_uring_peek_cqe(ring, cqe_ptr);
+	err = __io_uring_peek_cqe(ring, cqe_ptr, NULL);
 	if (err || *cqe_ptr)
 		return err;
 
@@ -508,6 +1265,64 @@ static inline int io_uring_wait_cqe(struct io_uring *ring,
 	return io_uring_wait_cqe_nr(ring, cqe_ptr, 1);
 }
 
+/*
+ * Sync internal state with kernel ring state on the SQ side. Returns the
+ * number of pending items in the SQ ring, for the shared ring.
+ *
+ * The SQ index array, if the ring has one, was set up as an identity mapping
+ * when the ring was mapped. Since sqes are always handed out in ring order,
+ * all that's left to do is to publish the new tail.
+ */
+static inline unsigned __io_uring_flush_sq(struct io_uring *ring)
+{
+	struct io_uring_sq *sq = &ring->sq;
+	unsigned tail = sq->sqe_tail;
+
+	if (sq->sqe_head != tail) {
+		sq->sqe_head = tail;
+		/*
+		 * Ensure that the kernel sees the SQE updates before it sees
+		 * the tail update.
+		 */
+		io_uring_smp_store_release(sq->ktail, tail);
+	}
+
+	return tail - *sq->khead;
+}
+
+static inline struct io_uring_sqe *_io_uring_get_sqe(struct io_uring *ring)
+{
+	struct io_uring_sq *sq = &ring->sq;
+	unsigned head = io_uring_smp_load_acquire(sq->khead);
+	unsigned next = sq->sqe_tail + 1;
+	struct io_uring_sqe *sqe = NULL;
+
+	if (next - head <= sq->ring_entries) {
+		sqe = &sq->sqes[(sq->sqe_tail & sq->ring_mask) << ring->sqe_shift];
+		sq->sqe_tail = next;
+	}
+	return sqe;
+}
+
+/*
+ * Return an sqe to fill. Application must later call io_uring_submit()
+ * when it's ready to tell the kernel about it. The caller may call this
+ * function multiple times before calling io_uring_submit().
+ *
+ * Returns a vacant sqe, or NULL if we're full.
+ *
+ * This is inlined for applications, the library still exports it for
+ * binaries built against older headers.
+ */
+#ifndef LIBURING_INTERNAL
+static inline struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring)
+{
+	return _io_uring_get_sqe(ring);
+}
+#else
+struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: MIT */
+#ifndef LIBURING_INT_FLAGS
+#define LIBURING_INT_FLAGS
+
+/*
+ * Library private flags, stored in io_uring->int_flags
+ */
+enum {
+	INT_FLAG_REG_RING	= 1,
+	INT_FLAG_APP_MEM	= 2,
+};
+
+#endif
@@ -1,4 +1,5 @@
 /* SPDX-License-Identifier: MIT */
+#define LIBURING_INTERNAL
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -6,6 +7,8 @@
 #include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <sched.h>
+#include <time.h>
 
 #include "liburing/compat.h"
 #include "liburing/io_uring.h"
@@ -13,6 +16,7 @@
 #include "liburing/barrier.h"
 
 #include "syscall.h"
+#include "int_flags.h"
 
 /*
  * Returns true if we're not using SQ thread (thus nobody submits but us)
@@ -32,46 +36,278 @@ static inline bool sq_ring_needs_enter(struct io_uring *ring,
 	return false;
 }
 
-int __io_uring_get_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr,
-		       unsigned submit, unsigned wait_nr, sigset_t *sigmask)
+/*
+ * Returns true if the kernel has flagged that task work is pending, which
+ * must be run for completions to be posted. With IORING_SETUP_DEFER_TASKRUN,
+ * that only happens when we enter with IORING_ENTER_GETEVENTS.
+ */
+static inline bool cq_ring_needs_enter(struct io_uring *ring)
+{
+	return io_uring_cq_needs_flush(ring);
+}
+
+/*
+ * How many times the CQ ring is checked between looking at the clock, when
+ * spinning for completions
+ */
+#define SPIN_CHECK_NR	16
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static unsigned long long spin_nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * With LIBURING_SPIN_ADAPTIVE, spin for twice the average time recent spins
+ * took to see their completions, but never less than an eighth of the budget
+ * so that we notice when completions start arriving early again. A spin that
+ * ran out counts as twice the budget, as we don't know how much longer the
+ * completion took, and the time spent sleeping isn't a good guess: if the
+ * completing side shares our CPU, our spinning is what delayed it.
+ */
+static unsigned spin_budget(struct io_uring *ring)
+{
+	unsigned max = ring->spin_nsec;
+	unsigned long long budget;
+
+	if (!(ring->spin_flags & LIBURING_SPIN_ADAPTIVE))
+		return max;
+	if (ring->spin_avg_nsec > max)
+		return max / 8;
+	budget = 2ULL * ring->spin_avg_nsec;
+	if (budget < max / 8)
+		return max / 8;
+	if (budget > max)
+		return max;
+	return budget;
+}
+
+static void spin_account(struct io_uring *ring, unsigned long long nsec)
+{
+	unsigned long long limit = 2ULL * ring->spin_nsec;
+
+	if (!(ring->spin_flags & LIBURING_SPIN_ADAPTIVE))
+		return;
+	if (nsec > limit)
+		nsec = limit;
+	ring->spin_avg_nsec = ring->spin_avg_nsec - ring->spin_avg_nsec / 8 +
+				nsec / 8;
+}
+
+/*
+ * Spin on the CQ ring until 'wait_nr' completions are ready or the spin
+ * budget runs out. Returns true in the former case, false if the caller
+ * should go to sleep in the kernel.
+ */
+static bool io_uring_spin_cqes(struct io_uring *ring, unsigned wait_nr)
+{
+	unsigned budget = spin_budget(ring);
+	unsigned long long start;
+	unsigned i;
+
+	start = spin_nsec_now();
+	do {
+		for (i = 0; i < SPIN_CHECK_NR; i++) {
+			if (io_uring_cq_ready(ring) >= wait_nr) {
+				spin_account(ring, spin_nsec_now() - start);
+				return true;
+			}
+			/* only entering the kernel will post these */
+			if (cq_ring_needs_enter(ring))
+				return false;
+			if (ring->spin_flags & LIBURING_SPIN_YIELD)
+				sched_yield();
+			else
+				cpu_relax();
+		}
+	} while (spin_nsec_now() - start < budget);
+
+	spin_account(ring, -1ULL);
+	return false;
+}
+
+struct get_data {
+	unsigned submit;
+	unsigned wait_nr;
+	unsigned get_flags;
+	int sz;
+	/*
+	 * The kernel may return with fewer than wait_nr events, eg once a
+	 * min wait timeout expired. Don't enter again if we got any.
+	 */
+	bool wait_once;
+	/* spin before waiting, see io_uring_set_spin_wait() */
+	bool spin;
+	void *arg;
+};
+
+static int _io_uring_get_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr,
+			     struct get_data *data)
 {
 	struct io_uring_cqe *cqe = NULL;
-	const int to_wait = wait_nr;
-	int ret = 0, err;
+	bool looped = false;
+	int err;
 
 	do {
+		bool need_enter = false;
 		unsigned flags = 0;
+		unsigned nr_available;
+		int ret;
 
-		err = __io_uring_peek_cqe(ring, &cqe);
+		err = __io_uring_peek_cqe(ring, &cqe, &nr_available);
 		if (err)
 			break;
-		if (!cqe && !to_wait && !submit) {
-			err = -EAGAIN;
+		if (cqe && looped && data->wait_once)
 			break;
+		if (!cqe && !data->wait_nr && !data->submit) {
+			/*
+			 * If we already looped once, we already entered the
+			 * kernel. Since there's nothing to submit or wait for,
+			 * don't keep retrying.
+			 */
+			if (looped || !cq_ring_needs_enter(ring)) {
+				err = -EAGAIN;
+				break;
+			}
+			need_enter = true;
+		}
+		if (data->wait_nr > nr_available || need_enter) {
+			flags = IORING_ENTER_GETEVENTS | data->get_flags;
+			need_enter = true;
 		}
-		if (wait_nr)
-			flags = IORING_ENTER_GETEVENTS;
-		if (submit)
-			sq_ring_needs_enter(ring, submit, &flags);
-		if (wait_nr || submit)
-			ret = __sys_io_uring_enter(ring->ring_fd, submit,
-						   wait_nr, flags, sigmask);
+		if (data->submit) {
+			sq_ring_needs_enter(ring, data->submit, &flags);
+			need_enter = true;
+		}
+		if (!need_enter)
+			break;
+		if (data->spin && !data->submit &&
+		    data->wait_nr > nr_available) {
+			data->spin = false;
+			if (io_uring_spin_cqes(ring, data->wait_nr))
+				continue;
+		}
+
+		if (ring->int_flags & INT_FLAG_REG_RING)
+			flags |= IORING_ENTER_REGISTERED_RING;
+		ret = __sys_io_uring_enter2(ring->enter_ring_fd, data->submit,
+					    data->wait_nr, flags, data->arg,
+					    data->sz);
 		if (ret < 0) {
-			err = -errno;
-		} else if (ret == (int)submit) {
-			submit = 0;
-			wait_nr = 0;
-		} else {
-			submit -= ret;
+			err = ret;
+			break;
 		}
+
+		data->submit -= ret;
 		if (cqe)
 			break;
-	} while (!err);
+		looped = true;
+	} while (1);
 
 	*cqe_ptr = cqe;
 	return err;
 }
 
+int __io_uring_get_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr,
+		       unsigned submit, unsigned wait_nr, sigset_t *sigmask)
+{
+	struct get_data data = {
+		.submit		= submit,
+		.wait_nr	= wait_nr,
+		.get_flags	= 0,
+		.sz		= _NSIG / 8,
+		.spin		= ring->spin_nsec != 0,
+		.arg		= sigmask,
+	};
+
+	return _io_uring_get_cqe(ring, cqe_ptr, &data);
+}
+
+/*
+ * Have waits for completions that don't submit anything or have a timeout,
+ * eg io_uring_wait_cqe(), spin on the CQ ring for up to 'spin_usec' before
+ * going to sleep in the kernel. That saves the sleep and wakeup when the
+ * completion usually follows within a few usec, at the cost of burning the
+ * CPU while it doesn't. A 'spin_usec' of 0 turns spinning off again.
+ *
+ * Spinning only pays off when the completion is posted without us entering
+ * the kernel, so it isn't available for IORING_SETUP_IOPOLL and
+ * IORING_SETUP_DEFER_TASKRUN rings.
+ *
+ * Returns 0 on success, -EINVAL for unknown flags, a budget over a second,
+ * or a ring that can't spin.
+ */
+int io_uring_set_spin_wait(struct io_uring *ring, unsigned spin_usec,
+			   unsigned flags)
+{
+	if (flags & ~(LIBURING_SPIN_ADAPTIVE | LIBURING_SPIN_YIELD))
+		return -EINVAL;
+	if (spin_usec > 1000000)
+		return -EINVAL;
+	if (spin_usec &&
+	    (ring->flags & (IORING_SETUP_IOPOLL | IORING_SETUP_DEFER_TASKRUN)))
+		return -EINVAL;
+
+	ring->spin_nsec = spin_usec * 1000;
+	ring->spin_flags = flags;
+	/* start out spinning for the full budget */
+	ring->spin_avg_nsec = ring->spin_nsec / 2;
+	return 0;
+}
+
+/*
+ * Enter the kernel to run any pending task work, and thereby post the
+ * completions it holds, without submitting or waiting for anything. Useful
+ * for rings setup with IORING_SETUP_COOP_TASKRUN or
+ * IORING_SETUP_DEFER_TASKRUN.
+ *
+ * Returns 0 on success, -errno on failure.
+ */
+int io_uring_get_events(struct io_uring *ring)
+{
+	unsigned flags = IORING_ENTER_GETEVENTS;
+	int ret;
+
+	if (ring->int_flags & INT_FLAG_REG_RING)
+		flags |= IORING_ENTER_REGISTERED_RING;
+	ret = __sys_io_uring_enter(ring->enter_ring_fd, 0, 0, flags, NULL);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+/*
+ * Like io_uring_cq_ready(), but if the CQ ring is empty while completions are
+ * held back in task work that won't run until we transition to the kernel,
+ * do a cheap flush first.
+ */
+static unsigned cq_ready_flush(struct io_uring *ring)
+{
+	unsigned ready;
+
+	ready = io_uring_cq_ready(ring);
+	if (!ready && cq_ring_needs_enter(ring)) {
+		io_uring_get_events(ring);
+		ready = io_uring_cq_ready(ring);
+	}
+	return ready;
+}
+
 /*
  * Fill in an array of IO completions up to count, if any are available.
  * Returns the amount of IO completions filled.
@@ -81,17 +317,18 @@ unsigned io_uring_peek_batch_cqe(struct io_uring *ring,
 {
 	unsigned ready;
 
-	ready = io_uring_cq_ready(ring);
+	ready = cq_ready_flush(ring);
 	if (ready) {
 		unsigned head = *ring->cq.khead;
-		unsigned mask = *ring->cq.kring_mask;
+		unsigned mask = ring->cq.ring_mask;
+		unsigned shift = ring->cqe_shift;
 		unsigned last;
 		int i = 0;
 
 		count = count > ready ? ready : count;
 		last = head + count;
 		for (;head != last; head++, i++)
-			cqes[i] = &ring->cq.cqes[head & mask];
+			cqes[i] = &ring->cq.cqes[(head & mask) << shift];
 
 		return count;
 	}
@@ -100,44 +337,105 @@ unsigned io_uring_peek_batch_cqe(struct io_uring *ring,
 }
 
 /*
- * Sync internal state with kernel ring state on the SQ side. Returns the
- * number of pending items in the SQ ring, for the shared ring.
+ * Copy up to 'count' available IO completions into 'cqes', and mark them
+ * seen. Unlike io_uring_peek_batch_cqe(), the CQ ring slots are handed back
+ * to the kernel straight away rather than once the caller has processed
+ * them, so a burst of completions doesn't overflow the CQ ring meanwhile.
+ * For IORING_SETUP_CQE32 rings, every completion takes two entries of
+ * 'cqes'.
+ *
+ * Returns the amount of IO completions copied.
  */
-static int __io_uring_flush_sq(struct io_uring *ring)
+unsigned io_uring_copy_cqes(struct io_uring *ring, struct io_uring_cqe *cqes,
+			    unsigned count)
 {
-	struct io_uring_sq *sq = &ring->sq;
-	const unsigned mask = *sq->kring_mask;
-	unsigned ktail, to_submit;
+	unsigned ready, head, mask, shift, first;
+
+	ready = cq_ready_flush(ring);
+	if (!ready)
+		return 0;
+
+	count = count > ready ? ready : count;
+	head = *ring->cq.khead;
+	mask = ring->cq.ring_mask;
+	shift = ring->cqe_shift;
+
+	/* copy up to the end of the ring, then the rest from its start */
+	first = ring->cq.ring_entries - (head & mask);
+	if (first > count)
+		first = count;
+	memcpy(cqes, &ring->cq.cqes[(head & mask) << shift],
+		(first * sizeof(*cqes)) << shift);
+	if (count > first)
+		memcpy(&cqes[first << shift], ring->cq.cqes,
+			((count - first) * sizeof(*cqes)) << shift);
+
+	io_uring_cq_advance(ring, count);
+	return count;
+}
 
-	if (sq->sqe_head == sq->sqe_tail) {
-		ktail = *sq->ktail;
-		goto out;
-	}
+/*
+ * Call 'fn' for up to 'count' available IO completions, in order, and then
+ * mark them all seen with a single update of the CQ head. The completions
+ * are only valid until 'fn' returns.
+ *
+ * Returns the amount of IO completions processed.
+ */
+unsigned io_uring_dispatch_cqes(struct io_uring *ring, io_uring_cqe_fn fn,
+				void *data, unsigned count)
+{
+	unsigned ready, head, last, mask, shift;
 
-	/*
-	 * Fill in sqes that we have queued up, adding them to the kernel ring
-	 */
-	ktail = *sq->ktail;
-	to_submit = sq->sqe_tail - sq->sqe_head;
-	while (to_submit--) {
-		sq->array[ktail & mask] = sq->sqe_head & mask;
-		ktail++;
-		sq->sqe_head++;
-	}
+	ready = cq_ready_flush(ring);
+	if (!ready)
+		return 0;
 
-	/*
-	 * Ensure that the kernel sees the SQE updates before it sees the tail
-	 * update.
-	 */
-	io_uring_smp_store_release(sq->ktail, ktail);
-out:
-	return ktail - *sq->khead;
+	count = count > ready ? ready : count;
+	head = *ring->cq.khead;
+	mask = ring->cq.ring_mask;
+	shift = ring->cqe_shift;
+	for (last = head + count; head != last; head++)
+		fn(ring, &ring->cq.cqes[(head & mask) << shift], data);
+
+	io_uring_cq_advance(ring, count);
+	return count;
+}
+
+/*
+ * Kernels with IORING_FEAT_EXT_ARG take the timeout and sigmask directly in
+ * io_uring_enter(2), so no sqe is needed to bound the wait. Any sqes that
+ * are pending are submitted as part of the same system call.
+ */
+static int io_uring_wait_cqes_new(struct io_uring *ring,
+				  struct io_uring_cqe **cqe_ptr,
+				  unsigned wait_nr,
+				  struct __kernel_timespec *ts,
+				  unsigned int min_wait_usec,
+				  sigset_t *sigmask)
+{
+	struct io_uring_getevents_arg arg = {
+		.sigmask	= (unsigned long) sigmask,
+		.sigmask_sz	= _NSIG / 8,
+		.min_wait_usec	= min_wait_usec,
+		.ts		= (unsigned long) ts
+	};
+	struct get_data data = {
+		.submit		= __io_uring_flush_sq(ring),
+		.wait_nr	= wait_nr,
+		.get_flags	= IORING_ENTER_EXT_ARG,
+		.sz		= sizeof(arg),
+		.wait_once	= min_wait_usec != 0,
+		.arg		= &arg
+	};
+
+	return _io_uring_get_cqe(ring, cqe_ptr, &data);
 }
 
 /*
- * Like io_uring_wait_cqe(), except it accepts a timeout value as well. Note
- * that an sqe is used internally to handle the timeout. Applications using
- * this function must never set sqe->user_data to LIBURING_UDATA_TIMEOUT!
+ * Like io_uring_wait_cqe(), except it accepts a timeout value as well. On
+ * kernels without IORING_FEAT_EXT_ARG, an sqe is used internally to handle
+ * the timeout. Applications using this function on such kernels must never
+ * set sqe->user_data to LIBURING_UDATA_TIMEOUT!
  *
  * If 'ts' is specified, the application need not call io_uring_submit() before
  * calling this function, as we will do that on its behalf. From this it also
@@ -155,6 +453,10 @@ int io_uring_wait_cqes(struct io_uring *ring, struct io_uring_cqe **cqe_ptr,
 		struct io_uring_sqe *sqe;
 		int ret;
 
+		if (ring->features & IORING_FEAT_EXT_ARG)
+			return io_uring_wait_cqes_new(ring, cqe_ptr, wait_nr,
+							ts, 0, sigmask);
+
 		/*
 		 * If the SQ ring is full, we may need to submit IO first
 		 */
@@ -175,6 +477,30 @@ int io_uring_wait_cqes(struct io_uring *ring, struct io_uring_cqe **cqe_ptr,
 	return __io_uring_get_cqe(ring, cqe_ptr, to_submit, wait_nr, sigmask);
 }
 
+/*
+ * Like io_uring_wait_cqes(), except that once 'min_wait_usec' has passed,
+ * the wait ends as soon as at least one cqe is available rather than when
+ * 'wait_nr' are. If none is available by then, it keeps waiting for the
+ * first one, bounded by 'ts' if given. This batches completions at low load
+ * without holding a lone completion for the whole of 'ts'.
+ *
+ * Kernels without IORING_FEAT_MIN_TIMEOUT ignore 'min_wait_usec' and behave
+ * like io_uring_wait_cqes().
+ */
+int io_uring_wait_cqes_min_timeout(struct io_uring *ring,
+				   struct io_uring_cqe **cqe_ptr,
+				   unsigned wait_nr,
+				   struct __kernel_timespec *ts,
+				   unsigned int min_wait_usec,
+				   sigset_t *sigmask)
+{
+	if (min_wait_usec && (ring->features & IORING_FEAT_MIN_TIMEOUT))
+		return io_uring_wait_cqes_new(ring, cqe_ptr, wait_nr, ts,
+						min_wait_usec, sigmask);
+
+	return io_uring_wait_cqes(ring, cqe_ptr, wait_nr, ts, sigmask);
+}
+
 /*
  * See io_uring_wait_cqes() - this function is the same, it just always uses
  * '1' as the wait_nr.
@@ -194,18 +520,27 @@ int io_uring_wait_cqe_timeout(struct io_uring *ring,
 static int __io_uring_submit(struct io_uring *ring, unsigned submitted,
 			     unsigned wait_nr)
 {
+	bool cq_needs_enter;
 	unsigned flags;
 	int ret;
 
+	/*
+	 * If task work is pending, have it run as part of the submit rather
+	 * than leaving completions stuck until the next wait.
+	 */
+	cq_needs_enter = wait_nr || cq_ring_needs_enter(ring);
+
 	flags = 0;
-	if (sq_ring_needs_enter(ring, submitted, &flags) || wait_nr) {
-		if (wait_nr || (ring->flags & IORING_SETUP_IOPOLL))
+	if (sq_ring_needs_enter(ring, submitted, &flags) || cq_needs_enter) {
+		if (cq_needs_enter || (ring->flags & IORING_SETUP_IOPOLL))
 			flags |= IORING_ENTER_GETEVENTS;
+		if (ring->int_flags & INT_FLAG_REG_RING)
+			flags |= IORING_ENTER_REGISTERED_RING;
 
-		ret = __sys_io_uring_enter(ring->ring_fd, submitted, wait_nr,
-						flags, NULL);
+		ret = __sys_io_uring_enter(ring->enter_ring_fd, submitted,
+						wait_nr, flags, NULL);
 		if (ret < 0)
-			return -errno;
+			return ret;
 	} else
 		ret = submitted;
 
@@ -237,27 +572,37 @@ int io_uring_submit_and_wait(struct io_uring *ring, unsigned wait_nr)
 	return __io_uring_submit_and_wait(ring, wait_nr);
 }
 
-#define __io_uring_get_sqe(sq, __head) ({				\
-	unsigned __next = (sq)->sqe_tail + 1;				\
-	struct io_uring_sqe *__sqe = NULL;				\
-									\
-	if (__next - __head <= *(sq)->kring_entries) {			\
-		__sqe = &(sq)->sqes[(sq)->sqe_tail & *(sq)->kring_mask];\
-		(sq)->sqe_tail = __next;				\
-	}								\
-	__sqe;								\
-})
+/*
+ * Out of line version of the io_uring_get_sqe() inline in liburing.h, for
+ * binaries built against headers that didn't have it
+ */
+struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring)
+{
+	return _io_uring_get_sqe(ring);
+}
 
 /*
- * Return an sqe to fill. Application must later call io_uring_submit()
- * when it's ready to tell the kernel about it. The caller may call this
- * function multiple times before calling io_uring_submit().
+ * Reserve 'count' sqes at once, storing them in 'sqes' in ring order. This
+ * only reads the kernel's SQ head once, rather than once per sqe as calling
+ * io_uring_get_sqe() 'count' times would. Wraparound of the SQ ring is
+ * handled, the sqes need not be adjacent in memory.
  *
- * Returns a vacant sqe, or NULL if we're full.
+ * Returns 'count', or 0 and reserves nothing if there isn't room for all.
  */
-struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring)
+unsigned io_uring_get_sqes(struct io_uring *ring, struct io_uring_sqe **sqes,
+			   unsigned count)
 {
 	struct io_uring_sq *sq = &ring->sq;
-
-	return __io_uring_get_sqe(sq, io_uring_smp_load_acquire(sq->khead));
+	unsigned head = io_uring_smp_load_acquire(sq->khead);
+	unsigned tail = sq->sqe_tail;
+	unsigned mask = sq->ring_mask;
+	unsigned i;
+
+	if (count > sq->ring_entries - (tail - head))
+		return 0;
+
+	for (i = 0; i < count; i++)
+		sqes[i] = &sq->sqes[((tail + i) & mask) << ring->sqe_shift];
+	sq->sqe_tail = tail + count;
+	return count;
 }
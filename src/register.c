@@ -11,6 +11,7 @@
 #include "liburing.h"
 
 #include "syscall.h"
+#include "int_flags.h"
 
 int io_uring_register_buffers(struct io_uring *ring, const struct iovec *iovecs,
 			      unsigned nr_iovecs)
@@ -20,11 +21,115 @@ int io_uring_register_buffers(struct io_uring *ring, const struct iovec *iovecs,
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS,
 					iovecs, nr_iovecs);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
 
+/*
+ * Like io_uring_register_buffers(), but with a tag per buffer. Once a buffer
+ * with a non-zero tag is replaced or unregistered, and no request uses it
+ * anymore, a CQE with the tag as user_data is posted. 'tags' may be NULL
+ * for no tags.
+ */
+int io_uring_register_buffers_tags(struct io_uring *ring,
+				   const struct iovec *iovecs,
+				   const __u64 *tags, unsigned nr)
+{
+	struct io_uring_rsrc_register reg = {
+		.nr	= nr,
+		.data	= (unsigned long) iovecs,
+		.tags	= (unsigned long) tags,
+	};
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS2,
+					&reg, sizeof(reg));
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+/*
+ * Register a buffer table of 'nr' empty slots, to be filled in with
+ * io_uring_register_buffers_update_tag()
+ */
+int io_uring_register_buffers_sparse(struct io_uring *ring, unsigned nr)
+{
+	struct io_uring_rsrc_register reg = {
+		.flags	= IORING_RSRC_REGISTER_SPARSE,
+		.nr	= nr,
+	};
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS2,
+					&reg, sizeof(reg));
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+/*
+ * Replace the 'nr' buffers starting at slot 'off' with 'iovecs' and their
+ * 'tags', leaving the rest of the table alone. An iovec with a NULL base
+ * and 0 length empties its slot. The old buffers stay pinned until the
+ * requests using them are done, which their tag CQEs signal.
+ *
+ * Returns number of buffers updated on success, -ERROR on failure.
+ */
+int io_uring_register_buffers_update_tag(struct io_uring *ring, unsigned off,
+					 const struct iovec *iovecs,
+					 const __u64 *tags, unsigned nr)
+{
+	struct io_uring_rsrc_update2 up = {
+		.offset	= off,
+		.data	= (unsigned long) iovecs,
+		.tags	= (unsigned long) tags,
+		.nr	= nr,
+	};
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd,
+					IORING_REGISTER_BUFFERS_UPDATE, &up,
+					sizeof(up));
+	return ret;
+}
+
+/*
+ * Share the 'nr' registered buffers of 'src' starting at slot 'src_off' with
+ * 'dst', as slots starting at 'dst_off'. The buffers are not pinned again,
+ * both rings reference the same pinned pages. 'nr' of 0 clones the whole
+ * table. Fails with -EBUSY if 'dst' already has buffers registered there,
+ * unless IORING_REGISTER_DST_REPLACE is set in 'flags'.
+ */
+int io_uring_clone_buffers_offset(struct io_uring *dst, struct io_uring *src,
+				  unsigned dst_off, unsigned src_off,
+				  unsigned nr, unsigned flags)
+{
+	struct io_uring_clone_buffers buf = {
+		.src_fd		= src->ring_fd,
+		.flags		= flags,
+		.src_off	= src_off,
+		.dst_off	= dst_off,
+		.nr		= nr,
+	};
+	int ret;
+
+	ret = __sys_io_uring_register(dst->ring_fd,
+					IORING_REGISTER_CLONE_BUFFERS, &buf, 1);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+int io_uring_clone_buffers(struct io_uring *dst, struct io_uring *src)
+{
+	return io_uring_clone_buffers_offset(dst, src, 0, 0, 0, 0);
+}
+
 int io_uring_unregister_buffers(struct io_uring *ring)
 {
 	int ret;
@@ -32,7 +137,7 @@ int io_uring_unregister_buffers(struct io_uring *ring)
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_BUFFERS,
 					NULL, 0);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
@@ -56,9 +161,6 @@ int io_uring_register_files_update(struct io_uring *ring, unsigned off,
 	ret = __sys_io_uring_register(ring->ring_fd,
 					IORING_REGISTER_FILES_UPDATE, &up,
 					nr_files);
-	if (ret < 0)
-		return -errno;
-
 	return ret;
 }
 
@@ -70,7 +172,51 @@ int io_uring_register_files(struct io_uring *ring, const int *files,
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_FILES,
 					files, nr_files);
 	if (ret < 0)
-		return -errno;
+		return ret;
+
+	return 0;
+}
+
+/*
+ * Register a file table of 'nr_files' empty slots, to be filled in with
+ * direct descriptors by io_uring_register_files_update() or by requests
+ * like io_uring_prep_openat_direct().
+ */
+int io_uring_register_files_sparse(struct io_uring *ring, unsigned nr_files)
+{
+	struct io_uring_rsrc_register reg = {
+		.flags	= IORING_RSRC_REGISTER_SPARSE,
+		.nr	= nr_files,
+	};
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_FILES2,
+					&reg, sizeof(reg));
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+/*
+ * Limit the slots that IORING_FILE_INDEX_ALLOC picks from to the 'len'
+ * slots starting at 'off', leaving the rest of the table for slots the
+ * application manages itself.
+ */
+int io_uring_register_file_alloc_range(struct io_uring *ring, unsigned off,
+				       unsigned len)
+{
+	struct io_uring_file_index_range range = {
+		.off	= off,
+		.len	= len,
+	};
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd,
+					IORING_REGISTER_FILE_ALLOC_RANGE,
+					&range, 0);
+	if (ret < 0)
+		return ret;
 
 	return 0;
 }
@@ -82,7 +228,7 @@ int io_uring_unregister_files(struct io_uring *ring)
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_FILES,
 					NULL, 0);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
@@ -94,7 +240,7 @@ int io_uring_register_eventfd(struct io_uring *ring, int event_fd)
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_EVENTFD,
 					&event_fd, 1);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
@@ -106,7 +252,7 @@ int io_uring_unregister_eventfd(struct io_uring *ring)
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_EVENTFD,
 					NULL, 0);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
@@ -118,7 +264,7 @@ int io_uring_register_eventfd_async(struct io_uring *ring, int event_fd)
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_EVENTFD_ASYNC,
 			&event_fd, 1);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
@@ -131,7 +277,7 @@ int io_uring_register_probe(struct io_uring *ring, struct io_uring_probe *p,
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PROBE,
 					p, nr_ops);
 	if (ret < 0)
-		return -errno;
+		return ret;
 
 	return 0;
 }
@@ -142,9 +288,6 @@ int io_uring_register_personality(struct io_uring *ring)
 
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PERSONALITY,
 					NULL, 0);
-	if (ret < 0)
-		return -errno;
-
 	return ret;
 }
 
@@ -154,8 +297,94 @@ int io_uring_unregister_personality(struct io_uring *ring, int id)
 
 	ret = __sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_PERSONALITY,
 					NULL, id);
+	return ret;
+}
+
+/*
+ * Register the ring file descriptor with the io_uring task context, so that
+ * io_uring_enter(2) can look it up by index rather than going through the
+ * process file table on every call. The registration is private to the
+ * registering task, a ring shared between threads should not be entered
+ * from other threads once registered.
+ *
+ * Returns 1 on success, -ERROR on failure.
+ */
+int io_uring_register_ring_fd(struct io_uring *ring)
+{
+	struct io_uring_rsrc_update up = {
+		.data	= ring->ring_fd,
+		.offset	= -1U,
+	};
+	int ret;
+
+	if (ring->int_flags & INT_FLAG_REG_RING)
+		return -EEXIST;
+
+	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_RING_FDS,
+					&up, 1);
 	if (ret < 0)
-		return -errno;
+		return ret;
+
+	if (ret == 1) {
+		ring->enter_ring_fd = up.offset;
+		ring->int_flags |= INT_FLAG_REG_RING;
+	}
+	return ret;
+}
+
+int io_uring_unregister_ring_fd(struct io_uring *ring)
+{
+	struct io_uring_rsrc_update up = {
+		.offset	= ring->enter_ring_fd,
+	};
+	int ret;
+
+	if (!(ring->int_flags & INT_FLAG_REG_RING))
+		return -EINVAL;
+
+	ret = __sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_RING_FDS,
+					&up, 1);
+	if (ret < 0)
+		return ret;
+
+	if (ret == 1) {
+		ring->enter_ring_fd = ring->ring_fd;
+		ring->int_flags &= ~INT_FLAG_REG_RING;
+	}
+	return ret;
+}
+
+int io_uring_register_buf_ring(struct io_uring *ring,
+			       struct io_uring_buf_reg *reg, unsigned int flags)
+{
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING,
+					reg, 1);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+int io_uring_unregister_buf_ring(struct io_uring *ring, int bgid)
+{
+	struct io_uring_buf_reg reg = { .bgid = bgid };
+	int ret;
+
+	ret = __sys_io_uring_register(ring->ring_fd,
+					IORING_UNREGISTER_PBUF_RING, &reg, 1);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+int io_uring_register_sync_msg(struct io_uring_sqe *sqe)
+{
+	int ret;
 
+	ret = __sys_io_uring_register(-1, IORING_REGISTER_SEND_MSG_RING,
+					sqe, 1);
 	return ret;
 }
@@ -12,6 +12,20 @@
 #include "liburing.h"
 
 #include "syscall.h"
+#include "int_flags.h"
+
+/*
+ * SQE128 and CQE32 rings use entries of twice the base struct size
+ */
+static unsigned io_uring_sqe_shift(unsigned flags)
+{
+	return !!(flags & IORING_SETUP_SQE128);
+}
+
+static unsigned io_uring_cqe_shift(unsigned flags)
+{
+	return !!(flags & IORING_SETUP_CQE32);
+}
 
 static void io_uring_unmap_rings(struct io_uring_sq *sq, struct io_uring_cq *cq)
 {
@@ -20,20 +34,82 @@ static void io_uring_unmap_rings(struct io_uring_sq *sq, struct io_uring_cq *cq)
 		munmap(cq->ring_ptr, cq->ring_sz);
 }
 
+/*
+ * Set up the SQ and CQ ring pointers from the offsets the kernel handed back,
+ * once sq->ring_ptr and cq->ring_ptr point at the ring memory.
+ */
+static void io_uring_setup_ring_pointers(struct io_uring_params *p,
+					 struct io_uring_sq *sq,
+					 struct io_uring_cq *cq)
+{
+	unsigned index;
+
+	sq->khead = sq->ring_ptr + p->sq_off.head;
+	sq->ktail = sq->ring_ptr + p->sq_off.tail;
+	sq->kring_mask = sq->ring_ptr + p->sq_off.ring_mask;
+	sq->kring_entries = sq->ring_ptr + p->sq_off.ring_entries;
+	sq->kflags = sq->ring_ptr + p->sq_off.flags;
+	sq->kdropped = sq->ring_ptr + p->sq_off.dropped;
+	if (!(p->flags & IORING_SETUP_NO_SQARRAY)) {
+		sq->array = sq->ring_ptr + p->sq_off.array;
+		/*
+		 * We always fill the SQ ring in order, so the index array is
+		 * an identity mapping. Set it up once, rather than on every
+		 * submit.
+		 */
+		for (index = 0; index < p->sq_entries; index++)
+			sq->array[index] = index;
+	}
+
+	cq->khead = cq->ring_ptr + p->cq_off.head;
+	cq->ktail = cq->ring_ptr + p->cq_off.tail;
+	cq->kring_mask = cq->ring_ptr + p->cq_off.ring_mask;
+	cq->kring_entries = cq->ring_ptr + p->cq_off.ring_entries;
+	cq->koverflow = cq->ring_ptr + p->cq_off.overflow;
+	cq->cqes = cq->ring_ptr + p->cq_off.cqes;
+
+	sq->ring_mask = *sq->kring_mask;
+	sq->ring_entries = *sq->kring_entries;
+	cq->ring_mask = *cq->kring_mask;
+	cq->ring_entries = *cq->kring_entries;
+}
+
 static int io_uring_mmap(int fd, struct io_uring_params *p,
 			 struct io_uring_sq *sq, struct io_uring_cq *cq)
 {
 	size_t size;
 	int ret;
 
-	sq->ring_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned);
-	cq->ring_sz = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	/*
+	 * Without the index array, the SQ ring fields all live in the same
+	 * mapping as the CQ ring. Kernels that support IORING_SETUP_NO_SQARRAY
+	 * or IORING_SETUP_NO_MMAP always have IORING_FEAT_SINGLE_MMAP.
+	 */
+	if (p->flags & IORING_SETUP_NO_SQARRAY)
+		sq->ring_sz = 0;
+	else
+		sq->ring_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	cq->ring_sz = p->cq_off.cqes + ((size_t) p->cq_entries *
+			sizeof(struct io_uring_cqe) << io_uring_cqe_shift(p->flags));
 
 	if (p->features & IORING_FEAT_SINGLE_MMAP) {
 		if (cq->ring_sz > sq->ring_sz)
 			sq->ring_sz = cq->ring_sz;
 		cq->ring_sz = sq->ring_sz;
 	}
+
+	/*
+	 * With IORING_SETUP_NO_MMAP, the rings live in memory that was passed
+	 * in at setup time, there's nothing to map
+	 */
+	if (p->flags & IORING_SETUP_NO_MMAP) {
+		sq->sqes = (void *) (uintptr_t) p->sq_off.user_addr;
+		sq->ring_ptr = (void *) (uintptr_t) p->cq_off.user_addr;
+		cq->ring_ptr = sq->ring_ptr;
+		io_uring_setup_ring_pointers(p, sq, cq);
+		return 0;
+	}
+
 	sq->ring_ptr = mmap(0, sq->ring_sz, PROT_READ | PROT_WRITE,
 			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
 	if (sq->ring_ptr == MAP_FAILED)
@@ -51,15 +127,8 @@ static int io_uring_mmap(int fd, struct io_uring_params *p,
 		}
 	}
 
-	sq->khead = sq->ring_ptr + p->sq_off.head;
-	sq->ktail = sq->ring_ptr + p->sq_off.tail;
-	sq->kring_mask = sq->ring_ptr + p->sq_off.ring_mask;
-	sq->kring_entries = sq->ring_ptr + p->sq_off.ring_entries;
-	sq->kflags = sq->ring_ptr + p->sq_off.flags;
-	sq->kdropped = sq->ring_ptr + p->sq_off.dropped;
-	sq->array = sq->ring_ptr + p->sq_off.array;
-
-	size = p->sq_entries * sizeof(struct io_uring_sqe);
+	size = (size_t) p->sq_entries * sizeof(struct io_uring_sqe) <<
+			io_uring_sqe_shift(p->flags);
 	sq->sqes = mmap(0, size, PROT_READ | PROT_WRITE,
 				MAP_SHARED | MAP_POPULATE, fd,
 				IORING_OFF_SQES);
@@ -70,12 +139,7 @@ err:
 		return ret;
 	}
 
-	cq->khead = cq->ring_ptr + p->cq_off.head;
-	cq->ktail = cq->ring_ptr + p->cq_off.tail;
-	cq->kring_mask = cq->ring_ptr + p->cq_off.ring_mask;
-	cq->kring_entries = cq->ring_ptr + p->cq_off.ring_entries;
-	cq->koverflow = cq->ring_ptr + p->cq_off.overflow;
-	cq->cqes = cq->ring_ptr + p->cq_off.cqes;
+	io_uring_setup_ring_pointers(p, sq, cq);
 	return 0;
 }
 
@@ -84,6 +148,10 @@ err:
  * interface is a convenient helper for mmap()ing the rings.
  * Returns -1 on error, or zero on success.  On success, 'ring'
  * contains the necessary information to read/write to the rings.
+ *
+ * If the ring was setup with IORING_SETUP_NO_MMAP, the memory passed in
+ * through sq_off.user_addr and cq_off.user_addr is used. It remains owned by
+ * the application, and must stay around until io_uring_queue_exit().
  */
 int io_uring_queue_mmap(int fd, struct io_uring_params *p, struct io_uring *ring)
 {
@@ -93,7 +161,12 @@ int io_uring_queue_mmap(int fd, struct io_uring_params *p, struct io_uring *ring
 	ret = io_uring_mmap(fd, p, &ring->sq, &ring->cq);
 	if (!ret) {
 		ring->flags = p->flags;
-		ring->ring_fd = fd;
+		ring->ring_fd = ring->enter_ring_fd = fd;
+		ring->features = p->features;
+		ring->sqe_shift = io_uring_sqe_shift(p->flags);
+		ring->cqe_shift = io_uring_cqe_shift(p->flags);
+		if (p->flags & IORING_SETUP_NO_MMAP)
+			ring->int_flags |= INT_FLAG_APP_MEM;
 	}
 	return ret;
 }
@@ -101,6 +174,9 @@ int io_uring_queue_mmap(int fd, struct io_uring_params *p, struct io_uring *ring
 /*
  * Ensure that the mmap'ed rings aren't available to a child after a fork(2).
  * This uses madvise(..., MADV_DONTFORK) on the mmap'ed ranges.
+ *
+ * Rings in memory the application passed to io_uring_queue_init_mem() are
+ * left to the application, and get -EINVAL.
  */
 int io_uring_ring_dontfork(struct io_uring *ring)
 {
@@ -110,7 +186,24 @@ int io_uring_ring_dontfork(struct io_uring *ring)
 	if (!ring->sq.ring_ptr || !ring->sq.sqes || !ring->cq.ring_ptr)
 		return -EINVAL;
 
-	len = *ring->sq.kring_entries * sizeof(struct io_uring_sqe);
+	/*
+	 * Memory we allocated for IORING_SETUP_NO_MMAP is a single region
+	 * starting with the SQEs, possibly a huge page. Only its start is
+	 * huge page aligned, so cover all of it in one go.
+	 */
+	if (ring->flags & IORING_SETUP_NO_MMAP) {
+		if (ring->int_flags & INT_FLAG_APP_MEM)
+			return -EINVAL;
+		len = (char *) ring->sq.ring_ptr + ring->sq.ring_sz -
+			(char *) ring->sq.sqes;
+		ret = madvise(ring->sq.sqes, len, MADV_DONTFORK);
+		if (ret == -1)
+			return -errno;
+		return 0;
+	}
+
+	len = (size_t) ring->sq.ring_entries * sizeof(struct io_uring_sqe) <<
+			ring->sqe_shift;
 	ret = madvise(ring->sq.sqes, len, MADV_DONTFORK);
 	if (ret == -1)
 		return -errno;
@@ -130,14 +223,14 @@ int io_uring_ring_dontfork(struct io_uring *ring)
 	return 0;
 }
 
-int io_uring_queue_init_params(unsigned entries, struct io_uring *ring,
-			       struct io_uring_params *p)
+static int __io_uring_queue_init_params(unsigned entries, struct io_uring *ring,
+					struct io_uring_params *p)
 {
 	int fd, ret;
 
 	fd = __sys_io_uring_setup(entries, p);
 	if (fd < 0)
-		return -errno;
+		return fd;
 
 	ret = io_uring_queue_mmap(fd, p, ring);
 	if (ret)
@@ -146,6 +239,209 @@ int io_uring_queue_init_params(unsigned entries, struct io_uring *ring,
 	return ret;
 }
 
+/*
+ * Kernel limits on the ring sizes
+ */
+#define KERN_MAX_ENTRIES	32768
+#define KERN_MAX_CQ_ENTRIES	(2 * KERN_MAX_ENTRIES)
+
+/*
+ * Upper bound on the size of the kernel's struct io_rings, which precedes
+ * the CQEs in the ring memory, and the cache line padding in front of the
+ * SQ index array. The real sizes depend on the cache line size.
+ */
+#define KRING_SIZE		1024
+
+#define HUGE_PAGE_SIZE		(2UL * 1024 * 1024)
+
+static unsigned roundup_pow2(unsigned depth)
+{
+	if (depth <= 1)
+		return 1;
+	return 1U << (32 - __builtin_clz(depth - 1));
+}
+
+static size_t align_size(size_t size, size_t align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+/*
+ * Mirrors how the kernel sizes the rings in io_uring_setup(2)
+ */
+static int get_sq_cq_entries(unsigned entries, struct io_uring_params *p,
+			     unsigned *sq, unsigned *cq)
+{
+	unsigned cq_entries;
+
+	if (!entries)
+		return -EINVAL;
+	if (entries > KERN_MAX_ENTRIES) {
+		if (!(p->flags & IORING_SETUP_CLAMP))
+			return -EINVAL;
+		entries = KERN_MAX_ENTRIES;
+	}
+
+	entries = roundup_pow2(entries);
+	if (p->flags & IORING_SETUP_CQSIZE) {
+		if (!p->cq_entries)
+			return -EINVAL;
+		cq_entries = p->cq_entries;
+		if (cq_entries > KERN_MAX_CQ_ENTRIES) {
+			if (!(p->flags & IORING_SETUP_CLAMP))
+				return -EINVAL;
+			cq_entries = KERN_MAX_CQ_ENTRIES;
+		}
+		cq_entries = roundup_pow2(cq_entries);
+		if (cq_entries < entries)
+			return -EINVAL;
+	} else {
+		cq_entries = 2 * entries;
+	}
+
+	*sq = entries;
+	*cq = cq_entries;
+	return 0;
+}
+
+/*
+ * Allocate 'size' bytes of ring memory, as a single huge page if one is
+ * available and big enough. Otherwise use huge page aligned regular pages,
+ * and ask for them to be backed by transparent huge pages. Returns the
+ * memory and updates 'size' to what was allocated, or NULL on failure.
+ */
+static void *io_uring_alloc_mem(size_t *size)
+{
+	size_t alloc_size;
+	char *ptr, *aligned;
+
+	if (*size <= HUGE_PAGE_SIZE) {
+		ptr = mmap(NULL, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) {
+			*size = HUGE_PAGE_SIZE;
+			return ptr;
+		}
+	}
+
+	/*
+	 * Shared anonymous memory is shmem, which usually isn't eligible for
+	 * transparent huge pages. Private memory is fine, the kernel pins it.
+	 * Over-allocate so we can trim the mapping to a huge page boundary.
+	 */
+	alloc_size = align_size(*size, HUGE_PAGE_SIZE);
+	ptr = mmap(NULL, alloc_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	aligned = (char *) align_size((uintptr_t) ptr, HUGE_PAGE_SIZE);
+	if (aligned != ptr)
+		munmap(ptr, aligned - ptr);
+	munmap(aligned + alloc_size, ptr + HUGE_PAGE_SIZE - aligned);
+	madvise(aligned, alloc_size, MADV_HUGEPAGE);
+
+	*size = alloc_size;
+	return aligned;
+}
+
+/*
+ * Like io_uring_queue_init_params(), but with the SQEs and rings placed in
+ * one region of memory provided by us rather than the kernel, using
+ * IORING_SETUP_NO_MMAP. That avoids spreading the rings over three separate
+ * mappings of regular pages, and the TLB misses that go with that.
+ *
+ * If 'buf' is NULL, the memory is allocated here, as a huge page if
+ * possible. If the kernel doesn't support IORING_SETUP_NO_MMAP or rejects
+ * the memory, we fall back to a regular ring with kernel allocated memory,
+ * unless IORING_SETUP_NO_MMAP was set in 'p->flags' by the caller.
+ *
+ * If 'buf' is given, it must be page aligned and at least 'buf_size' bytes.
+ * It remains owned by the application, and must stay around until
+ * io_uring_queue_exit(). Kernels before 6.13 require it to be a single
+ * (huge) page, with any remaining space usable for other rings. There is
+ * no fallback for a given 'buf'.
+ *
+ * Returns the number of bytes of memory used for the ring on success, 0 if
+ * we fell back to a regular ring that uses no memory from us, and -errno on
+ * failure.
+ */
+int io_uring_queue_init_mem(unsigned entries, struct io_uring *ring,
+			    struct io_uring_params *p,
+			    void *buf, size_t buf_size)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	unsigned sq_entries, cq_entries;
+	size_t sqes_mem, mem_used;
+	unsigned flags = p->flags;
+	__u64 sq_addr = p->sq_off.user_addr;
+	__u64 cq_addr = p->cq_off.user_addr;
+	char *mem = buf;
+	int ret;
+
+	ret = get_sq_cq_entries(entries, p, &sq_entries, &cq_entries);
+	if (ret)
+		return ret;
+
+	/*
+	 * SQEs go first, then the rings. Leave room for the SQ index array,
+	 * which is there unless IORING_SETUP_NO_SQARRAY is set.
+	 */
+	sqes_mem = align_size((size_t) sq_entries * sizeof(struct io_uring_sqe) <<
+				io_uring_sqe_shift(p->flags), page_size);
+	mem_used = sqes_mem + align_size(KRING_SIZE +
+				((size_t) cq_entries * sizeof(struct io_uring_cqe) <<
+				 io_uring_cqe_shift(p->flags)) +
+				sq_entries * sizeof(unsigned), page_size);
+
+	if (buf) {
+		if (buf_size < mem_used)
+			return -ENOMEM;
+	} else {
+		buf_size = mem_used;
+		mem = io_uring_alloc_mem(&buf_size);
+		if (!mem)
+			return -ENOMEM;
+	}
+
+	p->flags |= IORING_SETUP_NO_MMAP;
+	p->sq_off.user_addr = (unsigned long) mem;
+	p->cq_off.user_addr = (unsigned long) mem + sqes_mem;
+	ret = __io_uring_queue_init_params(entries, ring, p);
+	if (!ret) {
+		if (!buf) {
+			/* the ring memory extends to the end of our allocation */
+			ring->int_flags &= ~INT_FLAG_APP_MEM;
+			ring->sq.ring_sz = mem + buf_size - (char *) ring->sq.ring_ptr;
+			ring->cq.ring_sz = ring->sq.ring_sz;
+		}
+		return mem_used;
+	}
+
+	if (!buf)
+		munmap(mem, buf_size);
+	p->flags = flags;
+	p->sq_off.user_addr = sq_addr;
+	p->cq_off.user_addr = cq_addr;
+	if (buf || ret != -EINVAL || (flags & IORING_SETUP_NO_MMAP))
+		return ret;
+
+	return __io_uring_queue_init_params(entries, ring, p);
+}
+
+int io_uring_queue_init_params(unsigned entries, struct io_uring *ring,
+			       struct io_uring_params *p)
+{
+	int ret;
+
+	if (p->flags & IORING_SETUP_NO_MMAP) {
+		ret = io_uring_queue_init_mem(entries, ring, p, NULL, 0);
+		return ret < 0 ? ret : 0;
+	}
+
+	return __io_uring_queue_init_params(entries, ring, p);
+}
+
 /*
  * Returns -1 on error, or zero on success. On success, 'ring'
  * contains the necessary information to read/write to the rings.
@@ -160,16 +456,124 @@ int io_uring_queue_init(unsigned entries, struct io_uring *ring, unsigned flags)
 	return io_uring_queue_init_params(entries, ring, &p);
 }
 
+/*
+ * Like io_uring_queue_init(), but for rings that are only ever submitted to
+ * and reaped from by the calling task. Where supported, task work is then
+ * deferred until the application asks for events, rather than interrupting
+ * the task whenever a completion arrives. IORING_SQ_TASKRUN tells the
+ * library when it needs to enter the kernel for completions to be posted.
+ *
+ * Falls back to cooperative task running, IORING_SETUP_SINGLE_ISSUER alone,
+ * and then to a regular ring, on kernels that lack support. Check
+ * ring->flags to see what was set up.
+ */
+int io_uring_queue_init_single_issuer(unsigned entries, struct io_uring *ring,
+				      unsigned flags)
+{
+	static const unsigned extra_flags[] = {
+		IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+			IORING_SETUP_TASKRUN_FLAG,
+		IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN |
+			IORING_SETUP_TASKRUN_FLAG,
+		IORING_SETUP_SINGLE_ISSUER,
+		0,
+	};
+	unsigned i;
+	int ret = -EINVAL;
+
+	for (i = 0; i < sizeof(extra_flags) / sizeof(extra_flags[0]); i++) {
+		/* SQPOLL submits from the SQ thread, can't defer task work */
+		if ((flags & IORING_SETUP_SQPOLL) &&
+		    (extra_flags[i] & IORING_SETUP_DEFER_TASKRUN))
+			continue;
+		ret = io_uring_queue_init(entries, ring, flags | extra_flags[i]);
+		if (ret != -EINVAL)
+			break;
+	}
+
+	return ret;
+}
+
 void io_uring_queue_exit(struct io_uring *ring)
 {
 	struct io_uring_sq *sq = &ring->sq;
 	struct io_uring_cq *cq = &ring->cq;
 
-	munmap(sq->sqes, *sq->kring_entries * sizeof(struct io_uring_sqe));
-	io_uring_unmap_rings(sq, cq);
+	if (ring->flags & IORING_SETUP_NO_MMAP) {
+		/* we allocated the SQEs and rings as one region */
+		if (!(ring->int_flags & INT_FLAG_APP_MEM))
+			munmap(sq->sqes, (char *) sq->ring_ptr + sq->ring_sz -
+						(char *) sq->sqes);
+	} else {
+		munmap(sq->sqes, (size_t) sq->ring_entries *
+				sizeof(struct io_uring_sqe) << ring->sqe_shift);
+		io_uring_unmap_rings(sq, cq);
+	}
+	/*
+	 * Not strictly required, but frees up the slot we used now rather
+	 * than at the end of the task
+	 */
+	if (ring->int_flags & INT_FLAG_REG_RING)
+		io_uring_unregister_ring_fd(ring);
 	close(ring->ring_fd);
 }
 
+/*
+ * The buffer ring memory is ours, the kernel pins it on registration.
+ * 'flags' are passed on in io_uring_buf_reg->flags.
+ */
+struct io_uring_buf_ring *io_uring_setup_buf_ring(struct io_uring *ring,
+						  unsigned int nentries,
+						  int bgid, unsigned int flags,
+						  int *ret)
+{
+	struct io_uring_buf_ring *br;
+	struct io_uring_buf_reg reg;
+	size_t ring_size;
+	int err;
+
+	ring_size = nentries * sizeof(struct io_uring_buf);
+	br = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+		  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (br == MAP_FAILED) {
+		*ret = -errno;
+		return NULL;
+	}
+	io_uring_buf_ring_init(br);
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) (uintptr_t) br;
+	reg.ring_entries = nentries;
+	reg.bgid = bgid;
+	reg.flags = flags;
+
+	err = io_uring_register_buf_ring(ring, &reg, 0);
+	if (err) {
+		munmap(br, ring_size);
+		*ret = err;
+		return NULL;
+	}
+
+	*ret = 0;
+	return br;
+}
+
+/*
+ * Unregister and free a buffer ring set up with io_uring_setup_buf_ring()
+ */
+int io_uring_free_buf_ring(struct io_uring *ring, struct io_uring_buf_ring *br,
+			   unsigned int nentries, int bgid)
+{
+	int ret;
+
+	ret = io_uring_unregister_buf_ring(ring, bgid);
+	if (ret)
+		return ret;
+
+	munmap(br, nentries * sizeof(struct io_uring_buf));
+	return 0;
+}
+
 struct io_uring_probe *io_uring_get_probe_ring(struct io_uring *ring)
 {
 	struct io_uring_probe *probe;
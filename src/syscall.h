@@ -2,13 +2,82 @@
 #ifndef LIBURING_SYSCALL_H
 #define LIBURING_SYSCALL_H
 
+#include <signal.h>
+#include <sys/syscall.h>
+#include "liburing/compat.h"
+#include "liburing/io_uring.h"
+
+#ifdef __alpha__
+/*
+ * alpha is the only exception, all other architectures
+ * have common numbers for new system calls.
+ */
+# ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup		535
+# endif
+# ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter		536
+# endif
+# ifndef __NR_io_uring_register
+#  define __NR_io_uring_register	537
+# endif
+#else /* !__alpha__ */
+# ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup		425
+# endif
+# ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter		426
+# endif
+# ifndef __NR_io_uring_register
+#  define __NR_io_uring_register	427
+# endif
+#endif
+
+/*
+ * x86-64 and aarch64 issue the system calls inline, saving the errno store
+ * and the variadic call into libc. Define LIBURING_LIBC_SYSCALL to always
+ * use libc's syscall().
+ */
+#if defined(__x86_64__) && !defined(LIBURING_LIBC_SYSCALL)
+#include "arch/x86/syscall.h"
+#elif defined(__aarch64__) && !defined(LIBURING_LIBC_SYSCALL)
+#include "arch/aarch64/syscall.h"
+#else
+#include "arch/generic/syscall.h"
+#endif
+
 /*
- * System calls
+ * System calls. These return -errno on failure, errno is left alone.
  */
-extern int __sys_io_uring_setup(unsigned entries, struct io_uring_params *p);
-extern int __sys_io_uring_enter(int fd, unsigned to_submit,
-	unsigned min_complete, unsigned flags, sigset_t *sig);
-extern int __sys_io_uring_register(int fd, unsigned int opcode, const void *arg,
-	unsigned int nr_args);
+static inline int __sys_io_uring_setup(unsigned entries,
+				       struct io_uring_params *p)
+{
+	return (int) __do_syscall2(__NR_io_uring_setup, entries,
+				   (long) p);
+}
+
+static inline int __sys_io_uring_enter2(int fd, unsigned to_submit,
+					unsigned min_complete, unsigned flags,
+					void *arg, size_t sz)
+{
+	return (int) __do_syscall6(__NR_io_uring_enter, fd, to_submit,
+				   min_complete, flags, (long) arg, sz);
+}
+
+static inline int __sys_io_uring_enter(int fd, unsigned to_submit,
+				       unsigned min_complete, unsigned flags,
+				       sigset_t *sig)
+{
+	return __sys_io_uring_enter2(fd, to_submit, min_complete, flags, sig,
+				     _NSIG / 8);
+}
+
+static inline int __sys_io_uring_register(int fd, unsigned int opcode,
+					  const void *arg,
+					  unsigned int nr_args)
+{
+	return (int) __do_syscall4(__NR_io_uring_register, fd, opcode,
+				   (long) arg, nr_args);
+}
 
 #endif
@@ -0,0 +1,212 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test multishot accept, into the normal file table and as
+ *		direct descriptors allocated in the registered file table
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "liburing.h"
+
+#define NR_SLOTS	4
+
+static int no_multishot;
+
+static int start_listen(struct sockaddr_in *addr)
+{
+	socklen_t addrlen = sizeof(*addr);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *) addr, sizeof(*addr)) < 0 ||
+	    listen(fd, 128) < 0 ||
+	    getsockname(fd, (struct sockaddr *) addr, &addrlen) < 0) {
+		perror("bind/listen");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int connect_one(struct sockaddr_in *addr)
+{
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *) addr, sizeof(*addr)) < 0) {
+		perror("connect");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int test(int direct)
+{
+	struct sockaddr_in addr;
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	struct io_uring ring;
+	int files[NR_SLOTS];
+	int clients[NR_SLOTS + 1];
+	int slots_seen = 0;
+	int listen_fd, ret, i;
+
+	ret = io_uring_queue_init(16, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	listen_fd = start_listen(&addr);
+	if (listen_fd < 0)
+		return 1;
+
+	if (direct) {
+		/* empty slots for the accepted sockets to go into */
+		for (i = 0; i < NR_SLOTS; i++)
+			files[i] = -1;
+		ret = io_uring_register_files(&ring, files, NR_SLOTS);
+		if (ret) {
+			fprintf(stderr, "register files: %d\n", ret);
+			return 1;
+		}
+	}
+
+	sqe = io_uring_get_sqe(&ring);
+	if (direct)
+		io_uring_prep_multishot_accept_direct(sqe, listen_fd, NULL,
+						      NULL, 0);
+	else
+		io_uring_prep_multishot_accept(sqe, listen_fd, NULL, NULL, 0);
+	sqe->user_data = 1;
+	ret = io_uring_submit(&ring);
+	if (ret != 1) {
+		fprintf(stderr, "submit: %d\n", ret);
+		return 1;
+	}
+
+	/* one request, one cqe per connection */
+	for (i = 0; i < NR_SLOTS; i++) {
+		clients[i] = connect_one(&addr);
+		if (clients[i] < 0)
+			return 1;
+
+		ret = io_uring_wait_cqe(&ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			return 1;
+		}
+		if (cqe->res == -EINVAL && !i) {
+			/* older kernels reject the multishot flag */
+			no_multishot = 1;
+			io_uring_cqe_seen(&ring, cqe);
+			goto out;
+		}
+		if (cqe->res < 0 || !io_uring_cqe_more(cqe)) {
+			fprintf(stderr, "accept %d: res %d flags %x\n", i,
+				cqe->res, cqe->flags);
+			return 1;
+		}
+		if (direct) {
+			if (cqe->res >= NR_SLOTS ||
+			    (slots_seen & (1 << cqe->res))) {
+				fprintf(stderr, "bad slot %d\n", cqe->res);
+				return 1;
+			}
+			slots_seen |= 1 << cqe->res;
+		} else {
+			close(cqe->res);
+		}
+		io_uring_cqe_seen(&ring, cqe);
+	}
+
+	if (direct) {
+		/* out of slots, the multishot request terminates */
+		clients[i] = connect_one(&addr);
+		if (clients[i] < 0)
+			return 1;
+		ret = io_uring_wait_cqe(&ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			return 1;
+		}
+		if (cqe->res != -ENFILE || io_uring_cqe_more(cqe)) {
+			fprintf(stderr, "full table: res %d flags %x\n",
+				cqe->res, cqe->flags);
+			return 1;
+		}
+		io_uring_cqe_seen(&ring, cqe);
+		close(clients[i]);
+	} else {
+		/* cancel it, the final cqe must not have F_MORE set */
+		sqe = io_uring_get_sqe(&ring);
+		io_uring_prep_cancel(sqe, (void *) 1, 0);
+		sqe->user_data = 2;
+		io_uring_submit(&ring);
+
+		for (i = 0; i < 2; i++) {
+			ret = io_uring_wait_cqe(&ring, &cqe);
+			if (ret) {
+				fprintf(stderr, "wait cqe: %d\n", ret);
+				return 1;
+			}
+			if (cqe->user_data == 1 &&
+			    (cqe->res != -ECANCELED || io_uring_cqe_more(cqe))) {
+				fprintf(stderr, "cancelled: res %d flags %x\n",
+					cqe->res, cqe->flags);
+				return 1;
+			}
+			io_uring_cqe_seen(&ring, cqe);
+		}
+	}
+
+	for (i = 0; i < NR_SLOTS; i++)
+		close(clients[i]);
+out:
+	close(listen_fd);
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	ret = test(0);
+	if (ret) {
+		fprintf(stderr, "test multishot accept failed\n");
+		return ret;
+	}
+	if (no_multishot) {
+		fprintf(stdout, "Multishot accept not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test(1);
+	if (ret) {
+		fprintf(stderr, "test multishot accept direct failed\n");
+		return ret;
+	}
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test submitting and reaping on rings with 128 byte SQEs
+ *		and/or 32 byte CQEs, through all the cqe reaping helpers
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define RING_SIZE	8
+
+enum {
+	REAP_WAIT,
+	REAP_PEEK_BATCH,
+	REAP_FOR_EACH,
+};
+
+static int submit_nops(struct io_uring *ring, unsigned *seq)
+{
+	struct io_uring_sqe *sqe;
+	int i, ret;
+
+	for (i = 0; i < RING_SIZE; i++) {
+		sqe = io_uring_get_sqe(ring);
+		if (!sqe) {
+			fprintf(stderr, "get sqe failed\n");
+			return 1;
+		}
+		io_uring_prep_nop(sqe);
+		sqe->user_data = ++(*seq);
+	}
+
+	ret = io_uring_submit_and_wait(ring, RING_SIZE);
+	if (ret != RING_SIZE) {
+		fprintf(stderr, "submitted %d\n", ret);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int check_cqe(struct io_uring *ring, struct io_uring_cqe *cqe,
+		     unsigned *expected)
+{
+	if (cqe->res || cqe->user_data != ++(*expected)) {
+		fprintf(stderr, "bad cqe: user_data %llu res %d, expected %u\n",
+			(unsigned long long) cqe->user_data, cqe->res,
+			*expected);
+		return 1;
+	}
+	if ((ring->flags & IORING_SETUP_CQE32) &&
+	    (cqe->big_cqe[0] || cqe->big_cqe[1])) {
+		fprintf(stderr, "nop has big cqe data\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int reap_nops(struct io_uring *ring, int reap, unsigned *expected)
+{
+	struct io_uring_cqe *cqes[RING_SIZE];
+	struct io_uring_cqe *cqe;
+	unsigned head, nr;
+	int i, ret;
+
+	switch (reap) {
+	case REAP_WAIT:
+		for (i = 0; i < RING_SIZE; i++) {
+			ret = io_uring_wait_cqe(ring, &cqe);
+			if (ret) {
+				fprintf(stderr, "wait cqe: %d\n", ret);
+				return 1;
+			}
+			if (check_cqe(ring, cqe, expected))
+				return 1;
+			io_uring_cqe_seen(ring, cqe);
+		}
+		break;
+	case REAP_PEEK_BATCH:
+		nr = io_uring_peek_batch_cqe(ring, cqes, RING_SIZE);
+		if (nr != RING_SIZE) {
+			fprintf(stderr, "peek batch got %u\n", nr);
+			return 1;
+		}
+		for (i = 0; i < RING_SIZE; i++)
+			if (check_cqe(ring, cqes[i], expected))
+				return 1;
+		io_uring_cq_advance(ring, nr);
+		break;
+	case REAP_FOR_EACH:
+		nr = 0;
+		io_uring_for_each_cqe(ring, head, cqe) {
+			if (check_cqe(ring, cqe, expected))
+				return 1;
+			nr++;
+		}
+		if (nr != RING_SIZE) {
+			fprintf(stderr, "for each got %u\n", nr);
+			return 1;
+		}
+		io_uring_cq_advance(ring, nr);
+		break;
+	}
+
+	return 0;
+}
+
+static int test_ring(struct io_uring *ring)
+{
+	unsigned seq = 0, expected = 0;
+	int i, reap;
+
+	/* wrap the rings a few times with each way of reaping */
+	for (reap = REAP_WAIT; reap <= REAP_FOR_EACH; reap++) {
+		for (i = 0; i < 3; i++) {
+			if (submit_nops(ring, &seq))
+				return 1;
+			if (reap_nops(ring, reap, &expected))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int test_flags(unsigned flags, int mem)
+{
+	struct io_uring_params p;
+	struct io_uring ring;
+	int ret;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = flags;
+	if (mem)
+		ret = io_uring_queue_init_mem(RING_SIZE, &ring, &p, NULL, 0);
+	else
+		ret = io_uring_queue_init_params(RING_SIZE, &ring, &p);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Flags %x not supported, skipping\n", flags);
+		return 0;
+	} else if (ret < 0) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = test_ring(&ring);
+	io_uring_queue_exit(&ring);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned flags[] = {
+		0,
+		IORING_SETUP_SQE128,
+		IORING_SETUP_CQE32,
+		IORING_SETUP_SQE128 | IORING_SETUP_CQE32,
+	};
+	int i, mem;
+
+	for (mem = 0; mem < 2; mem++) {
+		for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+			if (test_flags(flags[i], mem)) {
+				fprintf(stderr, "test flags %x mem %d failed\n",
+					flags[i], mem);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test buffer selection from a registered provided buffer ring,
+ *		and recycling buffers through it
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define BGID		7
+#define NR_BUFS		8
+#define BUF_SIZE	64
+
+static char bufs[NR_BUFS][BUF_SIZE];
+
+static int queue_reads(struct io_uring *ring, int fd, int nr)
+{
+	struct io_uring_sqe *sqe;
+	int i, ret;
+
+	for (i = 0; i < nr; i++) {
+		sqe = io_uring_get_sqe(ring);
+		io_uring_prep_read(sqe, fd, NULL, BUF_SIZE, 0);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = BGID;
+		sqe->user_data = i + 1;
+	}
+
+	ret = io_uring_submit(ring);
+	if (ret != nr) {
+		fprintf(stderr, "submit: %d\n", ret);
+		return 1;
+	}
+	return 0;
+}
+
+static int test_reads(struct io_uring *ring, struct io_uring_buf_ring *br)
+{
+	struct io_uring_cqe *cqe;
+	int fds[2], i, ret, round;
+	int mask = io_uring_buf_ring_mask(NR_BUFS);
+	char data[BUF_SIZE];
+
+	if (pipe(fds) != 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	/* go around the buffer ring a few times, recycling as we go */
+	for (round = 0; round < 4 * NR_BUFS; round++) {
+		memset(data, round, sizeof(data));
+		if (write(fds[1], data, sizeof(data)) != sizeof(data)) {
+			perror("write");
+			goto err;
+		}
+		if (queue_reads(ring, fds[0], 1))
+			goto err;
+
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			goto err;
+		}
+		if (cqe->res != BUF_SIZE) {
+			fprintf(stderr, "read res %d\n", cqe->res);
+			goto err;
+		}
+		if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+			fprintf(stderr, "no buffer selected\n");
+			goto err;
+		}
+		i = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		if (i != round % NR_BUFS) {
+			fprintf(stderr, "got buffer %d, wanted %d\n", i,
+				round % NR_BUFS);
+			goto err;
+		}
+		if (memcmp(bufs[i], data, sizeof(data))) {
+			fprintf(stderr, "bad data in buffer %d\n", i);
+			goto err;
+		}
+
+		/* hand the buffer back and mark the cqe seen in one go */
+		io_uring_buf_ring_add(br, bufs[i], BUF_SIZE, i, mask, 0);
+		io_uring_buf_ring_cq_advance(ring, br, 1);
+	}
+
+	/* consume all the buffers without recycling, then run out */
+	for (i = 0; i < NR_BUFS; i++) {
+		if (write(fds[1], data, sizeof(data)) != sizeof(data)) {
+			perror("write");
+			goto err;
+		}
+	}
+	if (queue_reads(ring, fds[0], NR_BUFS + 1))
+		goto err;
+
+	for (i = 0; i < NR_BUFS + 1; i++) {
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			goto err;
+		}
+		if (cqe->res != BUF_SIZE && cqe->res != -ENOBUFS) {
+			fprintf(stderr, "exhaust read res %d\n", cqe->res);
+			goto err;
+		}
+		if (cqe->res == -ENOBUFS && cqe->user_data != NR_BUFS + 1) {
+			fprintf(stderr, "out of buffers early\n");
+			goto err;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+err:
+	close(fds[0]);
+	close(fds[1]);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring_buf_ring *br;
+	struct io_uring ring;
+	int ret, i;
+
+	ret = io_uring_queue_init(NR_BUFS * 2, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	br = io_uring_setup_buf_ring(&ring, NR_BUFS, BGID, 0, &ret);
+	if (!br) {
+		if (ret == -EINVAL) {
+			fprintf(stdout, "Buffer rings not supported, skipping\n");
+			return 0;
+		}
+		fprintf(stderr, "setup buf ring: %d\n", ret);
+		return 1;
+	}
+
+	if (io_uring_setup_buf_ring(&ring, NR_BUFS, BGID, 0, &ret) ||
+	    ret != -EEXIST) {
+		fprintf(stderr, "duplicate buf ring: %d\n", ret);
+		return 1;
+	}
+
+	for (i = 0; i < NR_BUFS; i++)
+		io_uring_buf_ring_add(br, bufs[i], BUF_SIZE, i,
+				      io_uring_buf_ring_mask(NR_BUFS), i);
+	io_uring_buf_ring_advance(br, NR_BUFS);
+
+	if (test_reads(&ring, br)) {
+		fprintf(stderr, "test_reads failed\n");
+		return 1;
+	}
+
+	ret = io_uring_free_buf_ring(&ring, br, NR_BUFS, BGID);
+	if (ret) {
+		fprintf(stderr, "free buf ring: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_unregister_buf_ring(&ring, BGID);
+	if (ret != -EINVAL && ret != -ENOENT) {
+		fprintf(stderr, "double unregister: %d\n", ret);
+		return 1;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
@@ -0,0 +1,231 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test tagged and sparse registered buffers, updating single
+ *		slots, and that the tag CQE of a replaced buffer is only
+ *		posted once no request uses it anymore
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define NR_BUFS		4
+#define BUF_SIZE	4096
+
+static char bufs[NR_BUFS + 1][BUF_SIZE];
+
+/*
+ * Return the user_data of the next cqe, checking it succeeded, or 0 if none
+ * shows up in time
+ */
+static __u64 next_cqe(struct io_uring *ring, int *res)
+{
+	struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 50000000 };
+	struct io_uring_cqe *cqe;
+	__u64 user_data;
+
+	if (io_uring_wait_cqe_timeout(ring, &cqe, &ts))
+		return 0;
+	user_data = cqe->user_data;
+	*res = cqe->res;
+	io_uring_cqe_seen(ring, cqe);
+	return user_data;
+}
+
+static int expect_tag(struct io_uring *ring, __u64 tag)
+{
+	__u64 user_data;
+	int res;
+
+	user_data = next_cqe(ring, &res);
+	if (user_data != tag || res) {
+		fprintf(stderr, "got cqe %llu res %d, expected tag %llu\n",
+			(unsigned long long) user_data, res,
+			(unsigned long long) tag);
+		return 1;
+	}
+	return 0;
+}
+
+static int test_sparse(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	struct iovec iov;
+	__u64 tag = 10;
+	int fds[2], ret, res;
+
+	ret = io_uring_register_buffers_sparse(ring, NR_BUFS);
+	if (ret) {
+		fprintf(stderr, "register sparse: %d\n", ret);
+		return 1;
+	}
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	/* empty slots can't be used */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_write_fixed(sqe, fds[1], bufs[0], 16, 0, 2);
+	sqe->user_data = 100;
+	io_uring_submit(ring);
+	if (next_cqe(ring, &res) != 100 || res != -EFAULT) {
+		fprintf(stderr, "write from empty slot: %d\n", res);
+		return 1;
+	}
+
+	iov.iov_base = bufs[0];
+	iov.iov_len = BUF_SIZE;
+	ret = io_uring_register_buffers_update_tag(ring, 2, &iov, &tag, 1);
+	if (ret != 1) {
+		fprintf(stderr, "update sparse slot: %d\n", ret);
+		return 1;
+	}
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_write_fixed(sqe, fds[1], bufs[0], 16, 0, 2);
+	sqe->user_data = 100;
+	io_uring_submit(ring);
+	if (next_cqe(ring, &res) != 100 || res != 16) {
+		fprintf(stderr, "write from filled slot: %d\n", res);
+		return 1;
+	}
+
+	ret = io_uring_unregister_buffers(ring);
+	if (ret || expect_tag(ring, tag))
+		return 1;
+
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+static int test_tags(struct io_uring *ring)
+{
+	__u64 tags[NR_BUFS] = { 1, 2, 0, 4 };
+	struct iovec iovs[NR_BUFS], iov;
+	struct io_uring_sqe *sqe;
+	__u64 new_tag = 5, user_data;
+	int fds[2], ret, res, i;
+
+	for (i = 0; i < NR_BUFS; i++) {
+		iovs[i].iov_base = bufs[i];
+		iovs[i].iov_len = BUF_SIZE;
+	}
+	ret = io_uring_register_buffers_tags(ring, iovs, tags, NR_BUFS);
+	if (ret) {
+		fprintf(stderr, "register tags: %d\n", ret);
+		return 1;
+	}
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	/* a read into buffer 0 that stays in flight */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_read_fixed(sqe, fds[0], bufs[0], 16, 0, 0);
+	sqe->user_data = 100;
+	io_uring_submit(ring);
+
+	iov.iov_base = bufs[NR_BUFS];
+	iov.iov_len = BUF_SIZE;
+	ret = io_uring_register_buffers_update_tag(ring, 0, &iov, &new_tag, 1);
+	if (ret != 1) {
+		fprintf(stderr, "update: %d\n", ret);
+		return 1;
+	}
+
+	/* the old buffer is still in use, so no tag yet */
+	user_data = next_cqe(ring, &res);
+	if (user_data) {
+		fprintf(stderr, "early cqe %llu\n",
+			(unsigned long long) user_data);
+		return 1;
+	}
+
+	if (write(fds[1], "hello", 5) != 5) {
+		perror("write");
+		return 1;
+	}
+	if (next_cqe(ring, &res) != 100 || res != 5 ||
+	    memcmp(bufs[0], "hello", 5)) {
+		fprintf(stderr, "fixed read: %d\n", res);
+		return 1;
+	}
+	if (expect_tag(ring, 1))
+		return 1;
+
+	/* the slot now refers to the new buffer */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_read_fixed(sqe, fds[0], bufs[NR_BUFS], 16, 0, 0);
+	sqe->user_data = 100;
+	io_uring_submit(ring);
+	if (write(fds[1], "world", 5) != 5) {
+		perror("write");
+		return 1;
+	}
+	if (next_cqe(ring, &res) != 100 || res != 5 ||
+	    memcmp(bufs[NR_BUFS], "world", 5)) {
+		fprintf(stderr, "read into updated slot: %d\n", res);
+		return 1;
+	}
+
+	/* unregistering posts the remaining non-zero tags */
+	ret = io_uring_unregister_buffers(ring);
+	if (ret) {
+		fprintf(stderr, "unregister: %d\n", ret);
+		return 1;
+	}
+	for (i = 0; i < 3; i++) {
+		user_data = next_cqe(ring, &res);
+		if ((user_data != 2 && user_data != 4 && user_data != 5) ||
+		    res) {
+			fprintf(stderr, "unregister tag %llu res %d\n",
+				(unsigned long long) user_data, res);
+			return 1;
+		}
+	}
+	if (next_cqe(ring, &res)) {
+		fprintf(stderr, "cqe for zero tag\n");
+		return 1;
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	if (!(ring.features & IORING_FEAT_RSRC_TAGS)) {
+		fprintf(stdout, "Resource tags not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_sparse(&ring);
+	if (ret) {
+		fprintf(stderr, "test_sparse failed\n");
+		return ret;
+	}
+
+	ret = test_tags(&ring);
+	if (ret) {
+		fprintf(stderr, "test_tags failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test cloning the registered buffers of one ring into
+ *		another, in whole and by range
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define NR_BUFS		4
+#define BUF_SIZE	4096
+
+static char bufs[NR_BUFS][BUF_SIZE];
+
+/*
+ * Write from registered buffer 'index' of 'ring', which should be 'buf',
+ * and check what arrives
+ */
+static int check_buf(struct io_uring *ring, int index, char *buf)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	char got[16];
+	int fds[2], ret;
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_write_fixed(sqe, fds[1], buf, sizeof(got), 0, index);
+	io_uring_submit(ring);
+	ret = io_uring_wait_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait cqe: %d\n", ret);
+		return 1;
+	}
+	ret = cqe->res;
+	io_uring_cqe_seen(ring, cqe);
+	if (ret != sizeof(got)) {
+		fprintf(stderr, "write_fixed %d: %d\n", index, ret);
+		return 1;
+	}
+	if (read(fds[0], got, sizeof(got)) != sizeof(got) ||
+	    memcmp(got, buf, sizeof(got))) {
+		fprintf(stderr, "bad data from buffer %d\n", index);
+		return 1;
+	}
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring src, dst;
+	struct iovec iovs[NR_BUFS];
+	int ret, i;
+
+	ret = io_uring_queue_init(8, &src, 0);
+	if (!ret)
+		ret = io_uring_queue_init(8, &dst, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	for (i = 0; i < NR_BUFS; i++) {
+		memset(bufs[i], 'a' + i, BUF_SIZE);
+		iovs[i].iov_base = bufs[i];
+		iovs[i].iov_len = BUF_SIZE;
+	}
+	ret = io_uring_register_buffers(&src, iovs, NR_BUFS);
+	if (ret) {
+		fprintf(stderr, "register buffers: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_clone_buffers(&dst, &src);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Clone buffers not supported, skipping\n");
+		return 0;
+	}
+	if (ret) {
+		fprintf(stderr, "clone buffers: %d\n", ret);
+		return 1;
+	}
+	for (i = 0; i < NR_BUFS; i++) {
+		if (check_buf(&dst, i, bufs[i]))
+			return 1;
+	}
+
+	/* the destination table is in use now */
+	ret = io_uring_clone_buffers(&dst, &src);
+	if (ret != -EBUSY) {
+		fprintf(stderr, "clone over existing table: %d\n", ret);
+		return 1;
+	}
+
+	/* unless replacing, here slots 2-3 with the source's 0-1 */
+	ret = io_uring_clone_buffers_offset(&dst, &src, 2, 0, 2,
+					    IORING_REGISTER_DST_REPLACE);
+	if (ret) {
+		fprintf(stderr, "clone range: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_unregister_buffers(&src);
+	if (ret) {
+		fprintf(stderr, "unregister source: %d\n", ret);
+		return 1;
+	}
+	/* slot 2 is buffer 0 now, and still usable without the source */
+	if (check_buf(&dst, 2, bufs[0]) || check_buf(&dst, 1, bufs[1]))
+		return 1;
+
+	io_uring_queue_exit(&src);
+	io_uring_queue_exit(&dst);
+	return 0;
+}
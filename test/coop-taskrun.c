@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test reaping completions on a IORING_SETUP_COOP_TASKRUN
+ *		ring that is triggered from another thread, while the
+ *		submitter stays in userspace
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/poll.h>
+
+#include "liburing.h"
+
+#define NR_LOOPS	32
+
+static void *writer_fn(void *data)
+{
+	int fd = *(int *) data;
+	char c = 'x';
+
+	usleep(1000);
+	if (write(fd, &c, 1) != 1)
+		perror("write");
+	return NULL;
+}
+
+static unsigned long long nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int test_loop(struct io_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	unsigned long long deadline;
+	pthread_t thread;
+	int fds[2], ret;
+	void *tret;
+
+	if (pipe(fds) != 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_poll_add(sqe, fds[0], POLLIN);
+	sqe->user_data = 1;
+
+	ret = io_uring_submit(ring);
+	if (ret != 1) {
+		fprintf(stderr, "submit: %d\n", ret);
+		goto err;
+	}
+
+	pthread_create(&thread, NULL, writer_fn, &fds[1]);
+
+	/* spin in userspace, peeking must get the completion posted */
+	deadline = nsec_now() + 1000000000ULL;
+	while (!io_uring_peek_batch_cqe(ring, &cqe, 1)) {
+		if (nsec_now() > deadline) {
+			fprintf(stderr, "timed out waiting for cqe\n");
+			pthread_join(thread, &tret);
+			goto err;
+		}
+	}
+	pthread_join(thread, &tret);
+
+	ret = io_uring_peek_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "peek: %d\n", ret);
+		goto err;
+	}
+	if (cqe->user_data != 1 || !(cqe->res & POLLIN)) {
+		fprintf(stderr, "bad cqe: %llu/%d\n",
+			(unsigned long long) cqe->user_data, cqe->res);
+		goto err;
+	}
+	io_uring_cqe_seen(ring, cqe);
+
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+err:
+	close(fds[0]);
+	close(fds[1]);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret, i;
+
+	ret = io_uring_queue_init(8, &ring, IORING_SETUP_COOP_TASKRUN |
+					IORING_SETUP_TASKRUN_FLAG);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Coop taskrun not supported, skipping\n");
+		return 0;
+	} else if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	for (i = 0; i < NR_LOOPS; i++) {
+		ret = test_loop(&ring);
+		if (ret) {
+			fprintf(stderr, "test_loop failed\n");
+			return ret;
+		}
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
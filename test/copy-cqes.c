@@ -0,0 +1,213 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test copying batches of cqes out of the CQ ring, and
+ *		dispatching them to a callback, across the wrap of the ring
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define RING_SIZE	8
+#define CQ_SIZE		(2 * RING_SIZE)
+
+static int submit_nops(struct io_uring *ring, unsigned nr, __u64 user_data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		sqe = io_uring_get_sqe(ring);
+		io_uring_prep_nop(sqe);
+		sqe->user_data = user_data + i;
+	}
+	ret = io_uring_submit_and_wait(ring, nr);
+	if (ret != nr) {
+		fprintf(stderr, "submit: %d\n", ret);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Move the CQ head so the next batch of 'nr' cqes wraps around the end of
+ * the ring
+ */
+static int wrap_cq(struct io_uring *ring, unsigned nr)
+{
+	unsigned head = *ring->cq.khead & ring->cq.ring_mask;
+	unsigned skip = (CQ_SIZE - head - nr / 2) % CQ_SIZE;
+
+	while (skip) {
+		unsigned this = skip > RING_SIZE ? RING_SIZE : skip;
+
+		if (submit_nops(ring, this, 0))
+			return 1;
+		io_uring_cq_advance(ring, this);
+		skip -= this;
+	}
+	return 0;
+}
+
+static int test_copy(struct io_uring *ring)
+{
+	unsigned shift = ring->cqe_shift;
+	struct io_uring_cqe cqes[(CQ_SIZE + 1) * 2];
+	unsigned i, ret, base = 100;
+
+	if (wrap_cq(ring, RING_SIZE))
+		return 1;
+	if (submit_nops(ring, RING_SIZE, base))
+		return 1;
+
+	/* a short copy leaves the rest in the ring */
+	ret = io_uring_copy_cqes(ring, cqes, 3);
+	if (ret != 3) {
+		fprintf(stderr, "short copy: %u\n", ret);
+		return 1;
+	}
+	if (io_uring_cq_ready(ring) != RING_SIZE - 3) {
+		fprintf(stderr, "%u left after short copy\n",
+			io_uring_cq_ready(ring));
+		return 1;
+	}
+	ret += io_uring_copy_cqes(ring, &cqes[3 << shift], CQ_SIZE + 1);
+	if (ret != RING_SIZE) {
+		fprintf(stderr, "copied %u\n", ret);
+		return 1;
+	}
+	if (io_uring_cq_ready(ring)) {
+		fprintf(stderr, "%u left after copy\n", io_uring_cq_ready(ring));
+		return 1;
+	}
+
+	for (i = 0; i < RING_SIZE; i++) {
+		struct io_uring_cqe *cqe = &cqes[i << shift];
+
+		if (cqe->user_data != base + i || cqe->res) {
+			fprintf(stderr, "cqe %u: %llu res %d\n", i,
+				(unsigned long long) cqe->user_data, cqe->res);
+			return 1;
+		}
+	}
+
+	if (io_uring_copy_cqes(ring, cqes, CQ_SIZE)) {
+		fprintf(stderr, "copied from empty ring\n");
+		return 1;
+	}
+	return 0;
+}
+
+struct dispatch {
+	__u64 next;
+	unsigned head;
+	int err;
+};
+
+static void dispatch_cqe(struct io_uring *ring, struct io_uring_cqe *cqe,
+			 void *data)
+{
+	struct dispatch *d = data;
+
+	if (cqe->user_data != d->next++ || cqe->res)
+		d->err = 1;
+	/* the head only moves once the whole batch is done */
+	if (*ring->cq.khead != d->head)
+		d->err = 1;
+}
+
+static int test_dispatch(struct io_uring *ring)
+{
+	struct dispatch d = { .next = 200, };
+	unsigned ret;
+
+	if (wrap_cq(ring, RING_SIZE))
+		return 1;
+	if (submit_nops(ring, RING_SIZE, d.next))
+		return 1;
+
+	d.head = *ring->cq.khead;
+	ret = io_uring_dispatch_cqes(ring, dispatch_cqe, &d, RING_SIZE - 2);
+	if (ret != RING_SIZE - 2 || d.err) {
+		fprintf(stderr, "dispatch: %u err %d\n", ret, d.err);
+		return 1;
+	}
+	if (*ring->cq.khead != d.head + ret) {
+		fprintf(stderr, "head moved by %u\n", *ring->cq.khead - d.head);
+		return 1;
+	}
+
+	d.head = *ring->cq.khead;
+	ret = io_uring_dispatch_cqes(ring, dispatch_cqe, &d, CQ_SIZE);
+	if (ret != 2 || d.err) {
+		fprintf(stderr, "dispatch rest: %u err %d\n", ret, d.err);
+		return 1;
+	}
+	if (io_uring_cq_ready(ring)) {
+		fprintf(stderr, "%u left after dispatch\n",
+			io_uring_cq_ready(ring));
+		return 1;
+	}
+	return 0;
+}
+
+static int test(unsigned flags)
+{
+	struct io_uring_params p = { };
+	struct io_uring ring;
+	int ret;
+
+	p.flags = flags;
+	ret = io_uring_queue_init_params(RING_SIZE, &ring, &p);
+	if (ret == -EINVAL && flags)
+		return 0;
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	if (ring.cq.ring_entries != CQ_SIZE) {
+		fprintf(stdout, "Unexpected CQ size %u, skipping\n",
+			ring.cq.ring_entries);
+		io_uring_queue_exit(&ring);
+		return 0;
+	}
+
+	ret = test_copy(&ring);
+	if (ret) {
+		fprintf(stderr, "test_copy failed\n");
+		return ret;
+	}
+
+	ret = test_dispatch(&ring);
+	if (ret) {
+		fprintf(stderr, "test_dispatch failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	ret = test(0);
+	if (ret) {
+		fprintf(stderr, "test failed\n");
+		return ret;
+	}
+
+	ret = test(IORING_SETUP_CQE32);
+	if (ret) {
+		fprintf(stderr, "test CQE32 failed\n");
+		return ret;
+	}
+
+	return 0;
+}
@@ -42,7 +42,7 @@ int main(int argc, char *argv[])
 	p.cq_entries = 0;
 
 	ret = io_uring_queue_init_params(4, &ring, &p);
-	if (ret >= 0 || errno != EINVAL) {
+	if (ret != -EINVAL) {
 		printf("zero sized cq ring succeeded\n");
 		goto err;
 	}
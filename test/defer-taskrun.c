@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test that completions on a IORING_SETUP_DEFER_TASKRUN ring
+ *		are found by peeking, even though the task work that posts
+ *		them only runs when we enter the kernel
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/poll.h>
+
+#include "liburing.h"
+
+enum {
+	REAP_PEEK,
+	REAP_SUBMIT,
+	REAP_PEEK_BATCH,
+};
+
+static int test_peek(struct io_uring *ring, int reap)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	int fds[2], ret, i;
+	char c = 'x';
+
+	if (pipe(fds) != 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_poll_add(sqe, fds[0], POLLIN);
+	sqe->user_data = 1;
+
+	ret = io_uring_submit(ring);
+	if (ret != 1) {
+		fprintf(stderr, "submit: %d\n", ret);
+		goto err;
+	}
+
+	ret = io_uring_peek_cqe(ring, &cqe);
+	if (ret != -EAGAIN) {
+		fprintf(stderr, "peek before trigger: %d\n", ret);
+		goto err;
+	}
+
+	/* triggers the poll, completion is posted through task work */
+	if (write(fds[1], &c, 1) != 1) {
+		perror("write");
+		goto err;
+	}
+
+	if (reap == REAP_SUBMIT) {
+		/* an empty submit should run the pending task work */
+		ret = io_uring_submit(ring);
+		if (ret) {
+			fprintf(stderr, "empty submit: %d\n", ret);
+			goto err;
+		}
+		if (!io_uring_cq_ready(ring)) {
+			fprintf(stderr, "no cqe after submit\n");
+			goto err;
+		}
+	}
+
+	if (reap == REAP_PEEK_BATCH) {
+		/* cq_ready only looks at the ring, it mustn't run task work */
+		usleep(10000);
+		if (io_uring_cq_ready(ring)) {
+			fprintf(stderr, "cq_ready posted the cqe\n");
+			goto err;
+		}
+		for (i = 0; i < 100; i++) {
+			if (io_uring_peek_batch_cqe(ring, &cqe, 1))
+				break;
+			usleep(1000);
+		}
+		if (i == 100) {
+			fprintf(stderr, "peek_batch never saw the cqe\n");
+			goto err;
+		}
+	}
+
+	/* poll wakeup may be a bit delayed, give it a few tries */
+	for (i = 0; i < 100; i++) {
+		ret = io_uring_peek_cqe(ring, &cqe);
+		if (ret != -EAGAIN)
+			break;
+		usleep(1000);
+	}
+	if (ret) {
+		fprintf(stderr, "peek after trigger: %d\n", ret);
+		goto err;
+	}
+	if (cqe->user_data != 1 || !(cqe->res & POLLIN)) {
+		fprintf(stderr, "bad cqe: %llu/%d\n",
+			(unsigned long long) cqe->user_data, cqe->res);
+		goto err;
+	}
+	io_uring_cqe_seen(ring, cqe);
+
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+err:
+	close(fds[0]);
+	close(fds[1]);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init_single_issuer(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	if (!(ring.flags & IORING_SETUP_DEFER_TASKRUN)) {
+		fprintf(stdout, "Defer taskrun not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_peek(&ring, REAP_PEEK);
+	if (ret) {
+		fprintf(stderr, "test_peek failed\n");
+		return ret;
+	}
+
+	ret = test_peek(&ring, REAP_SUBMIT);
+	if (ret) {
+		fprintf(stderr, "test_peek submit failed\n");
+		return ret;
+	}
+
+	ret = test_peek(&ring, REAP_PEEK_BATCH);
+	if (ret) {
+		fprintf(stderr, "test_peek peek_batch failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
@@ -0,0 +1,253 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test sparse file registration, the allocation range, and
+ *		opening, accepting and creating sockets straight into
+ *		registered file slots
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "liburing.h"
+
+#define NR_SLOTS	8
+#define ALLOC_OFF	2
+#define ALLOC_LEN	4
+
+#define TMP_FILE	".file-direct.tmp"
+
+static int submit_wait(struct io_uring *ring, struct io_uring_sqe *sqe,
+		       const char *what)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	io_uring_submit(ring);
+	ret = io_uring_wait_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "%s: wait cqe: %d\n", what, ret);
+		return ret;
+	}
+	ret = cqe->res;
+	io_uring_cqe_seen(ring, cqe);
+	return ret;
+}
+
+static int test_open(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	struct open_how how;
+	char buf[4];
+	int ret, fd, lowest_fd;
+
+	lowest_fd = dup(0);
+	close(lowest_fd);
+
+	/* into a fixed slot, outside the allocation range */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_openat_direct(sqe, AT_FDCWD, TMP_FILE,
+				    O_RDWR | O_CREAT | O_TRUNC, 0644, 0);
+	ret = submit_wait(ring, sqe, "openat");
+	if (ret) {
+		fprintf(stderr, "openat direct: %d\n", ret);
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_write(sqe, 0, "abcd", 4, 0);
+	sqe->flags |= IOSQE_FIXED_FILE;
+	ret = submit_wait(ring, sqe, "write");
+	if (ret != 4) {
+		fprintf(stderr, "fixed write: %d\n", ret);
+		return 1;
+	}
+
+	/* allocated, so the first slot of the range */
+	memset(&how, 0, sizeof(how));
+	how.flags = O_RDONLY;
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_openat2_direct(sqe, AT_FDCWD, TMP_FILE, &how,
+				     IORING_FILE_INDEX_ALLOC);
+	ret = submit_wait(ring, sqe, "openat2");
+	if (ret != ALLOC_OFF) {
+		fprintf(stderr, "openat2 direct alloc: %d\n", ret);
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_read(sqe, ALLOC_OFF, buf, sizeof(buf), 0);
+	sqe->flags |= IOSQE_FIXED_FILE;
+	ret = submit_wait(ring, sqe, "read");
+	if (ret != 4 || memcmp(buf, "abcd", 4)) {
+		fprintf(stderr, "fixed read: %d\n", ret);
+		return 1;
+	}
+
+	/* neither file is in the normal file table */
+	fd = dup(0);
+	close(fd);
+	if (fd != lowest_fd) {
+		fprintf(stderr, "direct open leaked fds\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int test_socket_accept(struct io_uring *ring)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	struct io_uring_sqe *sqe;
+	int listen_fd, client, ret, slot;
+	char buf[4];
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_socket_direct_alloc(sqe, AF_INET, SOCK_STREAM, 0, 0);
+	ret = submit_wait(ring, sqe, "socket");
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Direct socket not supported, skipping\n");
+		return 0;
+	}
+	if (ret != ALLOC_OFF + 1) {
+		fprintf(stderr, "socket direct alloc: %d\n", ret);
+		return 1;
+	}
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (listen_fd < 0 ||
+	    bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    listen(listen_fd, 4) < 0 ||
+	    getsockname(listen_fd, (struct sockaddr *) &addr, &addrlen) < 0) {
+		perror("listen");
+		return 1;
+	}
+	client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (client < 0 ||
+	    connect(client, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("connect");
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_accept_direct(sqe, listen_fd, NULL, NULL, 0,
+				    IORING_FILE_INDEX_ALLOC);
+	slot = submit_wait(ring, sqe, "accept");
+	if (slot != ALLOC_OFF + 2) {
+		fprintf(stderr, "accept direct alloc: %d\n", slot);
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_send(sqe, slot, "ping", 4, 0);
+	sqe->flags |= IOSQE_FIXED_FILE;
+	ret = submit_wait(ring, sqe, "send");
+	if (ret != 4 || recv(client, buf, 4, MSG_WAITALL) != 4 ||
+	    memcmp(buf, "ping", 4)) {
+		fprintf(stderr, "send on accepted slot: %d\n", ret);
+		return 1;
+	}
+
+	close(client);
+	close(listen_fd);
+	return 0;
+}
+
+static int test_alloc_full(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	int ret, i;
+
+	/* fill whatever is left of the range */
+	for (i = 0; ; i++) {
+		sqe = io_uring_get_sqe(ring);
+		io_uring_prep_openat_direct(sqe, AT_FDCWD, TMP_FILE, O_RDONLY,
+					    0, IORING_FILE_INDEX_ALLOC);
+		ret = submit_wait(ring, sqe, "openat");
+		if (ret == -ENFILE)
+			break;
+		if (ret < ALLOC_OFF || ret >= ALLOC_OFF + ALLOC_LEN ||
+		    i == ALLOC_LEN) {
+			fprintf(stderr, "alloc outside range: %d\n", ret);
+			return 1;
+		}
+	}
+
+	/* closing a slot makes it allocatable again */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_close_direct(sqe, ALLOC_OFF);
+	ret = submit_wait(ring, sqe, "close");
+	if (ret) {
+		fprintf(stderr, "close direct: %d\n", ret);
+		return 1;
+	}
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_openat_direct(sqe, AT_FDCWD, TMP_FILE, O_RDONLY, 0,
+				    IORING_FILE_INDEX_ALLOC);
+	ret = submit_wait(ring, sqe, "openat");
+	if (ret != ALLOC_OFF) {
+		fprintf(stderr, "alloc after close: %d\n", ret);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_register_files_sparse(&ring, NR_SLOTS);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Sparse files not supported, skipping\n");
+		return 0;
+	}
+	if (ret) {
+		fprintf(stderr, "register sparse: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_register_file_alloc_range(&ring, ALLOC_OFF, ALLOC_LEN);
+	if (ret) {
+		fprintf(stderr, "register alloc range: %d\n", ret);
+		return 1;
+	}
+
+	ret = test_open(&ring);
+	if (ret) {
+		fprintf(stderr, "test_open failed\n");
+		goto err;
+	}
+
+	ret = test_socket_accept(&ring);
+	if (ret) {
+		fprintf(stderr, "test_socket_accept failed\n");
+		goto err;
+	}
+
+	ret = test_alloc_full(&ring);
+	if (ret) {
+		fprintf(stderr, "test_alloc_full failed\n");
+		goto err;
+	}
+
+	unlink(TMP_FILE);
+	io_uring_queue_exit(&ring);
+	return 0;
+err:
+	unlink(TMP_FILE);
+	return 1;
+}
@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test futex wait, wake and waitv through the ring, and that
+ *		they interact with plain futex(2) users
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "liburing.h"
+
+#ifndef FUTEX2_SIZE_U32
+#define FUTEX2_SIZE_U32		0x02
+#endif
+#ifndef FUTEX2_PRIVATE
+#define FUTEX2_PRIVATE		128
+#endif
+
+#define FUTEX_FLAGS	(FUTEX2_SIZE_U32 | FUTEX2_PRIVATE)
+
+static int no_futex;
+
+/*
+ * Return the res of the cqe for 'user_data', or -ETIME if none shows up in
+ * time. Any other cqe is an error.
+ */
+static int wait_one(struct io_uring *ring, __u64 user_data)
+{
+	struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 50000000 };
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	ret = io_uring_wait_cqe_timeout(ring, &cqe, &ts);
+	if (ret)
+		return ret;
+	ret = cqe->res;
+	if (cqe->user_data != user_data) {
+		fprintf(stderr, "got cqe %llu res %d, wanted %llu\n",
+			(unsigned long long) cqe->user_data, ret,
+			(unsigned long long) user_data);
+		ret = -EINVAL;
+	}
+	io_uring_cqe_seen(ring, cqe);
+	return ret;
+}
+
+static int test_wait_wake(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	__u32 futex = 0;
+	int ret, i;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_futex_wait(sqe, &futex, 0, FUTEX_BITSET_MATCH_ANY,
+				 FUTEX_FLAGS, 0);
+	sqe->user_data = 1;
+	io_uring_submit(ring);
+
+	ret = wait_one(ring, 1);
+	if (ret == -EINVAL || ret == -EOPNOTSUPP) {
+		no_futex = 1;
+		return 0;
+	}
+	if (ret != -ETIME) {
+		fprintf(stderr, "futex wait completed early: %d\n", ret);
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_futex_wake(sqe, &futex, 1, FUTEX_BITSET_MATCH_ANY,
+				 FUTEX_FLAGS, 0);
+	sqe->user_data = 2;
+	io_uring_submit(ring);
+
+	/* the wake and the woken wait may complete in either order */
+	for (i = 0; i < 2; i++) {
+		struct io_uring_cqe *cqe;
+
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			return 1;
+		}
+		if ((cqe->user_data == 1 && cqe->res) ||
+		    (cqe->user_data == 2 && cqe->res != 1) ||
+		    (cqe->user_data != 1 && cqe->user_data != 2)) {
+			fprintf(stderr, "futex wake cqe %llu res %d\n",
+				(unsigned long long) cqe->user_data, cqe->res);
+			return 1;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+
+	/* a value mismatch fails straight away */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_futex_wait(sqe, &futex, 1, FUTEX_BITSET_MATCH_ANY,
+				 FUTEX_FLAGS, 0);
+	sqe->user_data = 3;
+	io_uring_submit(ring);
+	ret = wait_one(ring, 3);
+	if (ret != -EAGAIN) {
+		fprintf(stderr, "futex wait mismatch: %d\n", ret);
+		return 1;
+	}
+	return 0;
+}
+
+static void *wake_thread(void *data)
+{
+	__u32 *futex = data;
+
+	usleep(10000);
+	__atomic_store_n(futex, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	return NULL;
+}
+
+/*
+ * A waiter in the ring is woken by a thread using the futex syscall, as it
+ * would be by an unlock or condition signal
+ */
+static int test_wake_syscall(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	pthread_t thread;
+	__u32 futex = 0;
+	int ret;
+
+	/*
+	 * Start the thread before arming the wait, the first thread created
+	 * may move the process to its own private futex hash
+	 */
+	pthread_create(&thread, NULL, wake_thread, &futex);
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_futex_wait(sqe, &futex, 0, FUTEX_BITSET_MATCH_ANY,
+				 FUTEX_FLAGS, 0);
+	sqe->user_data = 4;
+	io_uring_submit(ring);
+
+	ret = wait_one(ring, 4);
+	pthread_join(thread, NULL);
+	if (ret) {
+		fprintf(stderr, "futex wait woken by syscall: %d\n", ret);
+		return 1;
+	}
+	if (__atomic_load_n(&futex, __ATOMIC_ACQUIRE) != 1) {
+		fprintf(stderr, "woken before the store\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int test_waitv(struct io_uring *ring)
+{
+	struct futex_waitv fw[2];
+	struct io_uring_sqe *sqe;
+	__u32 futex[2] = { 0, 0 };
+	int ret, i;
+
+	memset(fw, 0, sizeof(fw));
+	for (i = 0; i < 2; i++) {
+		fw[i].uaddr = (unsigned long) &futex[i];
+		fw[i].val = 0;
+		fw[i].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_futex_waitv(sqe, fw, 2, 0);
+	sqe->user_data = 5;
+	io_uring_submit(ring);
+
+	ret = wait_one(ring, 5);
+	if (ret != -ETIME) {
+		fprintf(stderr, "futex waitv completed early: %d\n", ret);
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_futex_wake(sqe, &futex[1], 1, FUTEX_BITSET_MATCH_ANY,
+				 FUTEX_FLAGS, 0);
+	sqe->user_data = 6;
+	sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+	io_uring_submit(ring);
+
+	/* res is the index of the futex that was woken */
+	ret = wait_one(ring, 5);
+	if (ret != 1) {
+		fprintf(stderr, "futex waitv: %d\n", ret);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = test_wait_wake(&ring);
+	if (ret) {
+		fprintf(stderr, "test_wait_wake failed\n");
+		return ret;
+	}
+	if (no_futex) {
+		fprintf(stdout, "Futex ops not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_wake_syscall(&ring);
+	if (ret) {
+		fprintf(stderr, "test_wake_syscall failed\n");
+		return ret;
+	}
+
+	ret = test_waitv(&ring);
+	if (ret) {
+		fprintf(stderr, "test_waitv failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
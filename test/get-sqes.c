@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test reserving several sqes at once, across the wrap of the
+ *		SQ ring, and preparing a batch of block reads in them
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "liburing.h"
+
+#define RING_SIZE	8
+#define BS		512
+#define NR_READS	6
+
+#define TMP_FILE	".get-sqes.tmp"
+
+static int submit_nops(struct io_uring *ring, unsigned nr)
+{
+	struct io_uring_cqe *cqe;
+	unsigned i;
+
+	for (i = 0; i < nr; i++)
+		io_uring_prep_nop(io_uring_get_sqe(ring));
+	if (io_uring_submit_and_wait(ring, nr) != nr) {
+		fprintf(stderr, "nop submit failed\n");
+		return 1;
+	}
+	for (i = 0; i < nr; i++) {
+		if (io_uring_wait_cqe(ring, &cqe))
+			return 1;
+		io_uring_cqe_seen(ring, cqe);
+	}
+	return 0;
+}
+
+static int test_full(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqes[RING_SIZE];
+	unsigned i, ret;
+
+	ret = io_uring_get_sqes(ring, sqes, RING_SIZE);
+	if (ret != RING_SIZE) {
+		fprintf(stderr, "get %d sqes: %u\n", RING_SIZE, ret);
+		return 1;
+	}
+	for (i = 0; i < RING_SIZE; i++) {
+		if (sqes[i] != &ring->sq.sqes[i]) {
+			fprintf(stderr, "sqe %u out of order\n", i);
+			return 1;
+		}
+	}
+	if (io_uring_get_sqe(ring) || io_uring_get_sqes(ring, sqes, 1)) {
+		fprintf(stderr, "got sqe from full ring\n");
+		return 1;
+	}
+
+	for (i = 0; i < RING_SIZE; i++)
+		io_uring_prep_nop(sqes[i]);
+	ret = io_uring_submit_and_wait(ring, RING_SIZE);
+	if (ret != RING_SIZE) {
+		fprintf(stderr, "submit: %d\n", (int) ret);
+		return 1;
+	}
+	io_uring_cq_advance(ring, RING_SIZE);
+	return 0;
+}
+
+static int test_wrap_read(struct io_uring *ring, int fd)
+{
+	struct io_uring_sqe *sqes[NR_READS];
+	struct io_uring_cqe *cqe;
+	char buf[NR_READS * BS];
+	unsigned i, ret;
+
+	/* move the tail so the batch wraps around the end of the ring */
+	if (submit_nops(ring, RING_SIZE - NR_READS / 2))
+		return 1;
+
+	ret = io_uring_get_sqes(ring, sqes, NR_READS);
+	if (ret != NR_READS) {
+		fprintf(stderr, "get %d sqes: %u\n", NR_READS, ret);
+		return 1;
+	}
+	if (sqes[NR_READS / 2] != &ring->sq.sqes[0]) {
+		fprintf(stderr, "batch didn't wrap\n");
+		return 1;
+	}
+
+	memset(buf, 0, sizeof(buf));
+	io_uring_prep_read_many(sqes, NR_READS, fd, buf, BS, 0);
+	for (i = 0; i < NR_READS; i++)
+		sqes[i]->user_data = i;
+	ret = io_uring_submit_and_wait(ring, NR_READS);
+	if (ret != NR_READS) {
+		fprintf(stderr, "submit: %d\n", (int) ret);
+		return 1;
+	}
+
+	for (i = 0; i < NR_READS; i++) {
+		if (io_uring_wait_cqe(ring, &cqe))
+			return 1;
+		if (cqe->res != BS) {
+			fprintf(stderr, "read %llu: %d\n",
+				(unsigned long long) cqe->user_data, cqe->res);
+			return 1;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+	for (i = 0; i < sizeof(buf); i++) {
+		if (buf[i] != (char) (i / BS)) {
+			fprintf(stderr, "bad data at %u\n", i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * A batch that doesn't fit reserves nothing
+ */
+static int test_no_room(struct io_uring *ring)
+{
+	struct io_uring_sqe *sqes[RING_SIZE];
+	unsigned ret;
+
+	ret = io_uring_get_sqes(ring, sqes, RING_SIZE - 2);
+	if (ret != RING_SIZE - 2) {
+		fprintf(stderr, "get %d sqes: %u\n", RING_SIZE - 2, ret);
+		return 1;
+	}
+	ret = io_uring_get_sqes(ring, sqes, 3);
+	if (ret) {
+		fprintf(stderr, "got %u sqes without room\n", ret);
+		return 1;
+	}
+	/* counts that would wrap the free space check */
+	ret = io_uring_get_sqes(ring, sqes, ~0U);
+	if (ret) {
+		fprintf(stderr, "got %u sqes for ~0U\n", ret);
+		return 1;
+	}
+	ret = io_uring_get_sqes(ring, sqes, -(RING_SIZE - 2));
+	if (ret) {
+		fprintf(stderr, "got %u sqes for %u\n", ret, -(RING_SIZE - 2));
+		return 1;
+	}
+	if (io_uring_sq_space_left(ring) != 2) {
+		fprintf(stderr, "failed get changed space: %u\n",
+			io_uring_sq_space_left(ring));
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char block[BS];
+	struct io_uring ring;
+	int ret, fd, i;
+
+	ret = io_uring_queue_init(RING_SIZE, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	fd = open(TMP_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror("open");
+		return 1;
+	}
+	unlink(TMP_FILE);
+	for (i = 0; i < NR_READS; i++) {
+		memset(block, i, BS);
+		if (write(fd, block, BS) != BS) {
+			perror("write");
+			return 1;
+		}
+	}
+
+	ret = test_full(&ring);
+	if (ret) {
+		fprintf(stderr, "test_full failed\n");
+		return ret;
+	}
+
+	ret = test_wrap_read(&ring, fd);
+	if (ret) {
+		fprintf(stderr, "test_wrap_read failed\n");
+		return ret;
+	}
+
+	ret = test_no_room(&ring);
+	if (ret) {
+		fprintf(stderr, "test_no_room failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	close(fd);
+	return 0;
+}
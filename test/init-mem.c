@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test setting up rings in library allocated and application
+ *		provided memory with IORING_SETUP_NO_MMAP
+ *
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "liburing.h"
+
+#define BUF_SIZE	(2 * 1024 * 1024)
+
+static int test_nops(struct io_uring *ring, int nr)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	int i, ret;
+
+	for (i = 0; i < nr; i++) {
+		sqe = io_uring_get_sqe(ring);
+		if (!sqe) {
+			fprintf(stderr, "get sqe failed\n");
+			goto err;
+		}
+		io_uring_prep_nop(sqe);
+		sqe->user_data = i + 1;
+	}
+
+	ret = io_uring_submit(ring);
+	if (ret != nr) {
+		fprintf(stderr, "submitted %d, wanted %d\n", ret, nr);
+		goto err;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret < 0) {
+			fprintf(stderr, "wait completion %d\n", ret);
+			goto err;
+		}
+		if (cqe->user_data != i + 1) {
+			fprintf(stderr, "got user_data %llu, wanted %d\n",
+				(unsigned long long) cqe->user_data, i + 1);
+			goto err;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+
+	return 0;
+err:
+	return 1;
+}
+
+/*
+ * After io_uring_ring_dontfork(), a child touching the rings should fault
+ */
+static int test_dontfork(struct io_uring *ring)
+{
+	int ret, status;
+	pid_t pid;
+
+	ret = io_uring_ring_dontfork(ring);
+	if (ret) {
+		fprintf(stderr, "dontfork: %d\n", ret);
+		return 1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	} else if (!pid) {
+		/* both the SQEs and the rings must be gone */
+		if (*(volatile __u8 *) &ring->sq.sqes->opcode == 0xff)
+			exit(2);
+		if (*(volatile unsigned *) ring->cq.khead == ~0U)
+			exit(2);
+		exit(0);
+	}
+	if (waitpid(pid, &status, 0) != pid) {
+		perror("waitpid");
+		return 1;
+	}
+	if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGSEGV) {
+		fprintf(stderr, "child could access the rings: %x\n", status);
+		return 1;
+	}
+	return 0;
+}
+
+static int test_lib_mem(unsigned entries, unsigned flags)
+{
+	struct io_uring_params p;
+	struct io_uring ring;
+	int ret, i;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = flags;
+	ret = io_uring_queue_init_mem(entries, &ring, &p, NULL, 0);
+	if (ret == -EINVAL && (flags & IORING_SETUP_NO_MMAP)) {
+		fprintf(stdout, "NO_MMAP not supported, skipping\n");
+		return 0;
+	} else if (ret < 0) {
+		fprintf(stderr, "init_mem: %d\n", ret);
+		return 1;
+	}
+	if (ret && !(ring.flags & IORING_SETUP_NO_MMAP)) {
+		fprintf(stderr, "init_mem used memory without NO_MMAP\n");
+		return 1;
+	}
+	/* 0 means we fell back to a regular ring */
+	if (!ret && (flags & IORING_SETUP_NO_MMAP)) {
+		fprintf(stderr, "init_mem fell back despite NO_MMAP\n");
+		return 1;
+	}
+
+	/* go around the rings a few times */
+	for (i = 0; i < 8; i++) {
+		if (test_nops(&ring, entries)) {
+			fprintf(stderr, "lib mem nops failed\n");
+			return 1;
+		}
+	}
+
+	if (test_dontfork(&ring)) {
+		fprintf(stderr, "lib mem dontfork failed\n");
+		return 1;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+
+static int test_app_mem(void)
+{
+	struct io_uring_params p;
+	struct io_uring rings[2];
+	size_t off = 0;
+	void *buf;
+	int ret, i;
+
+	buf = mmap(NULL, BUF_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (buf == MAP_FAILED) {
+		/* small rings only need a page per region, any memory works */
+		buf = mmap(NULL, BUF_SIZE, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+	}
+
+	memset(&p, 0, sizeof(p));
+	ret = io_uring_queue_init_mem(32768, &rings[0], &p, buf, 4096);
+	if (ret != -ENOMEM) {
+		fprintf(stderr, "too small buffer: %d\n", ret);
+		return 1;
+	}
+
+	/* carve two rings out of the same huge page */
+	for (i = 0; i < 2; i++) {
+		memset(&p, 0, sizeof(p));
+		ret = io_uring_queue_init_mem(64, &rings[i], &p,
+					      (char *) buf + off, BUF_SIZE - off);
+		if (ret == -EINVAL) {
+			fprintf(stdout, "NO_MMAP not supported, skipping\n");
+			return 0;
+		} else if (ret < 0) {
+			fprintf(stderr, "init_mem %d: %d\n", i, ret);
+			return 1;
+		}
+		off += ret;
+
+		/* the rings must cover the CQEs, as laid out by the kernel */
+		if ((char *) rings[i].cq.ring_ptr + rings[i].cq.ring_sz <
+		    (char *) &rings[i].cq.cqes[*rings[i].cq.kring_entries]) {
+			fprintf(stderr, "ring %d size %zu\n", i,
+				rings[i].cq.ring_sz);
+			return 1;
+		}
+		/* the memory is the application's to madvise */
+		ret = io_uring_ring_dontfork(&rings[i]);
+		if (ret != -EINVAL) {
+			fprintf(stderr, "dontfork app mem: %d\n", ret);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (test_nops(&rings[i], 16)) {
+			fprintf(stderr, "app mem nops failed\n");
+			return 1;
+		}
+		io_uring_queue_exit(&rings[i]);
+	}
+
+	munmap(buf, BUF_SIZE);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = test_lib_mem(8, 0);
+	if (ret) {
+		fprintf(stderr, "test_lib_mem 8 failed\n");
+		return ret;
+	}
+
+	/* too big for a single huge page */
+	ret = test_lib_mem(32768, 0);
+	if (ret) {
+		fprintf(stderr, "test_lib_mem 32768 failed\n");
+		return ret;
+	}
+
+	ret = test_lib_mem(8, IORING_SETUP_NO_MMAP);
+	if (ret) {
+		fprintf(stderr, "test_lib_mem NO_MMAP failed\n");
+		return ret;
+	}
+
+	ret = test_app_mem();
+	if (ret) {
+		fprintf(stderr, "test_app_mem failed\n");
+		return ret;
+	}
+
+	ret = io_uring_queue_init(8, &ring, IORING_SETUP_NO_MMAP);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "NO_MMAP not supported, skipping\n");
+		return 0;
+	} else if (ret) {
+		fprintf(stderr, "queue_init NO_MMAP: %d\n", ret);
+		return 1;
+	}
+	if (test_nops(&ring, 8)) {
+		fprintf(stderr, "NO_MMAP nops failed\n");
+		return 1;
+	}
+	io_uring_queue_exit(&ring);
+
+	return 0;
+}
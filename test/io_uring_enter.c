@@ -40,8 +40,8 @@ expect_failed_submit(struct io_uring *ring, int error)
 		return 1;
 	}
 
-	if (errno != error) {
-		printf("expected %d, got %d\n", error, errno);
+	if (ret != -error) {
+		printf("expected %d, got %d\n", error, -ret);
 		return 1;
 	}
 
@@ -55,13 +55,13 @@ expect_fail(int fd, unsigned int to_submit, unsigned int min_complete,
 	int ret;
 
 	ret = __sys_io_uring_enter(fd, to_submit, min_complete, flags, sig);
-	if (ret != -1) {
+	if (ret >= 0) {
 		printf("expected %s, but call succeeded\n", strerror(error));
 		return 1;
 	}
 
-	if (errno != error) {
-		printf("expected %d, got %d\n", error, errno);
+	if (ret != -error) {
+		printf("expected %d, got %d\n", error, -ret);
 		return 1;
 	}
 
@@ -83,7 +83,7 @@ try_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
 
 	ret = __sys_io_uring_enter(fd, to_submit, min_complete, flags, sig);
 	if (ret != expect) {
-		printf("Expected %d, got %d\n", expect, errno);
+		printf("Expected %d, got %d\n", expect, ret);
 		return 1;
 	}
 
@@ -195,6 +195,7 @@ submit_io(struct io_uring *ring, unsigned nr)
 	ret = io_uring_submit(ring);
 	unlink(template);
 	if (ret < 0) {
+		errno = -ret;
 		perror("io_uring_enter");
 		exit(1);
 	}
@@ -238,6 +239,7 @@ main(int argc, char **argv)
 	ret = __sys_io_uring_enter(ring.ring_fd, 0, sq_entries,
 					IORING_ENTER_GETEVENTS, NULL);
 	if (ret < 0) {
+		errno = -ret;
 		perror("io_uring_enter");
 		status = 1;
 	} else {
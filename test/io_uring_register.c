@@ -38,7 +38,7 @@ expect_fail(int fd, unsigned int opcode, void *arg,
 	printf("io_uring_register(%d, %u, %p, %u)\n",
 	       fd, opcode, arg, nr_args);
 	ret = __sys_io_uring_register(fd, opcode, arg, nr_args);
-	if (ret != -1) {
+	if (ret >= 0) {
 		int ret2 = 0;
 
 		printf("expected %s, but call succeeded\n", strerror(error));
@@ -56,8 +56,8 @@ expect_fail(int fd, unsigned int opcode, void *arg,
 		return 1;
 	}
 
-	if (errno != error) {
-		printf("expected %d, got %d\n", error, errno);
+	if (ret != -error) {
+		printf("expected %d, got %d\n", error, -ret);
 		return 1;
 	}
 	return 0;
@@ -70,6 +70,7 @@ new_io_uring(int entries, struct io_uring_params *p)
 
 	fd = __sys_io_uring_setup(entries, p);
 	if (fd < 0) {
+		errno = -fd;
 		perror("io_uring_setup");
 		exit(1);
 	}
@@ -207,9 +208,8 @@ test_max_fds(int uring_fd)
 		ret = __sys_io_uring_register(uring_fd, IORING_UNREGISTER_FILES,
 						0, 0);
 		if (ret < 0) {
-			ret = errno;
 			printf("failed\n");
-			errno = ret;
+			errno = -ret;
 			perror("io_uring_register UNREGISTER_FILES");
 			exit(1);
 		}
@@ -247,13 +247,13 @@ test_memlock_exceeded(int fd)
 	while (iov.iov_len) {
 		ret = __sys_io_uring_register(fd, IORING_REGISTER_BUFFERS, &iov, 1);
 		if (ret < 0) {
-			if (errno == ENOMEM) {
+			if (ret == -ENOMEM) {
 				printf("io_uring_register of %zu bytes failed "
 				       "with ENOMEM (expected).\n", iov.iov_len);
 				iov.iov_len /= 2;
 				continue;
 			}
-			printf("expected success or EFAULT, got %d\n", errno);
+			printf("expected success or EFAULT, got %d\n", -ret);
 			free(buf);
 			return 1;
 		}
@@ -262,7 +262,7 @@ test_memlock_exceeded(int fd)
 		ret = __sys_io_uring_register(fd, IORING_UNREGISTER_BUFFERS,
 						NULL, 0);
 		if (ret != 0) {
-			printf("error: unregister failed with %d\n", errno);
+			printf("error: unregister failed with %d\n", -ret);
 			free(buf);
 			return 1;
 		}
@@ -302,7 +302,7 @@ test_iovec_nr(int fd)
 	       fd, IORING_REGISTER_BUFFERS, iovs, nr);
 	ret = __sys_io_uring_register(fd, IORING_REGISTER_BUFFERS, iovs, nr);
 	if (ret != 0) {
-		printf("expected success, got %d\n", errno);
+		printf("expected success, got %d\n", -ret);
 		status = 1;
 	} else
 		__sys_io_uring_register(fd, IORING_UNREGISTER_BUFFERS, 0, 0);
@@ -362,13 +362,13 @@ test_iovec_size(int fd)
 		iov.iov_len = 2*1024*1024;
 		ret = __sys_io_uring_register(fd, IORING_REGISTER_BUFFERS, &iov, 1);
 		if (ret < 0) {
-			if (errno == ENOMEM)
+			if (ret == -ENOMEM)
 				printf("Unable to test registering of a huge "
 				       "page.  Try increasing the "
 				       "RLIMIT_MEMLOCK resource limit by at "
 				       "least 2MB.");
 			else {
-				printf("expected success, got %d\n", errno);
+				printf("expected success, got %d\n", -ret);
 				status = 1;
 			}
 		} else {
@@ -376,6 +376,7 @@ test_iovec_size(int fd)
 			ret = __sys_io_uring_register(fd,
 					IORING_UNREGISTER_BUFFERS, 0, 0);
 			if (ret < 0) {
+				errno = -ret;
 				perror("io_uring_unregister");
 				status = 1;
 			}
@@ -421,6 +422,10 @@ ioring_poll(struct io_uring *ring, int fd, int fixed)
 	struct io_uring_cqe *cqe;
 
 	sqe = io_uring_get_sqe(ring);
+	if (!sqe) {
+		printf("failed to get an sqe.\n");
+		return 1;
+	}
 	memset(sqe, 0, sizeof(*sqe));
 	sqe->opcode = IORING_OP_POLL_ADD;
 	if (fixed)
@@ -432,7 +437,7 @@ ioring_poll(struct io_uring *ring, int fd, int fixed)
 	dump_sqe(sqe);
 	ret = io_uring_submit(ring);
 	if (ret != 1) {
-		printf("failed to submit poll sqe: %d.\n", errno);
+		printf("failed to submit poll sqe: %d.\n", ret);
 		return 1;
 	}
 
@@ -99,13 +99,17 @@ dump_resv(struct io_uring_params *p)
 int
 try_io_uring_setup(unsigned entries, struct io_uring_params *p, int expect, int error)
 {
-	int ret, __errno;
+	int ret, __errno = 0;
 
 	printf("io_uring_setup(%u, %p), flags: %s, feat: %s, resv: %s, sq_thread_cpu: %u\n",
 	       entries, p, flags_string(p), features_string(p), dump_resv(p),
 	       p ? p->sq_thread_cpu : 0);
 
 	ret = __sys_io_uring_setup(entries, p);
+	if (ret < 0) {
+		__errno = -ret;
+		ret = -1;
+	}
 	if (ret != expect) {
 		printf("expected %d, got %d\n", expect, ret);
 		/* if we got a valid uring, close it */
@@ -113,7 +117,6 @@ try_io_uring_setup(unsigned entries, struct io_uring_params *p, int expect, int
 			close(ret);
 		return 1;
 	}
-	__errno = errno;
 	if (expect == -1 && error != __errno) {
 		if (__errno == EPERM && geteuid() != 0) {
 			printf("Needs root, not flagging as an error\n");
@@ -167,7 +170,7 @@ main(int argc, char **argv)
 	fd = __sys_io_uring_setup(1, &p);
 	if (fd < 0) {
 		printf("io_uring_setup failed with %d, expected success\n",
-		       errno);
+		       -fd);
 		status = 1;
 	} else {
 		char buf[4096];
@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test IORING_OP_MSG_RING, posting data CQEs and passing
+ *		registered files from one ring to another, and posting
+ *		without a submitting ring
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define NR_SLOTS	4
+
+static int no_msg_ring;
+
+static int wait_one(struct io_uring *ring, __u64 user_data, int res,
+		    unsigned flags)
+{
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	ret = io_uring_wait_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait cqe: %d\n", ret);
+		return 1;
+	}
+	if (cqe->user_data != user_data || cqe->res != res ||
+	    cqe->flags != flags) {
+		fprintf(stderr, "cqe: user_data %llu res %d flags %x, "
+			"expected %llu %d %x\n",
+			(unsigned long long) cqe->user_data, cqe->res,
+			cqe->flags, (unsigned long long) user_data, res, flags);
+		return 1;
+	}
+	io_uring_cqe_seen(ring, cqe);
+	return 0;
+}
+
+static int test_data(struct io_uring *src, struct io_uring *dst)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	int ret;
+
+	sqe = io_uring_get_sqe(src);
+	io_uring_prep_msg_ring(sqe, dst->ring_fd, 0x1234, 0xdeadbeef, 0);
+	sqe->user_data = 1;
+	io_uring_submit(src);
+
+	ret = io_uring_wait_cqe(src, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait cqe: %d\n", ret);
+		return 1;
+	}
+	if (cqe->res == -EINVAL) {
+		no_msg_ring = 1;
+		io_uring_cqe_seen(src, cqe);
+		return 0;
+	}
+	if (cqe->res) {
+		fprintf(stderr, "msg_ring: %d\n", cqe->res);
+		return 1;
+	}
+	io_uring_cqe_seen(src, cqe);
+	if (wait_one(dst, 0xdeadbeef, 0x1234, 0))
+		return 1;
+
+	/* passing cqe flags, and no completion on the source */
+	sqe = io_uring_get_sqe(src);
+	io_uring_prep_msg_ring_cqe_flags(sqe, dst->ring_fd, 17, 2, 0,
+					 IORING_CQE_F_MORE);
+	sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+	io_uring_submit(src);
+	if (wait_one(dst, 2, 17, IORING_CQE_F_MORE))
+		return 1;
+	if (io_uring_peek_cqe(src, &cqe) != -EAGAIN) {
+		fprintf(stderr, "skipped cqe posted\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int test_fd(struct io_uring *src, struct io_uring *dst)
+{
+	struct io_uring_sqe *sqe;
+	int fds[2], files[NR_SLOTS], ret, i;
+	char buf[8];
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	/* source has the pipe write end at 0, target is all free slots */
+	for (i = 0; i < NR_SLOTS; i++)
+		files[i] = -1;
+	files[0] = fds[1];
+	ret = io_uring_register_files(src, files, NR_SLOTS);
+	if (ret) {
+		fprintf(stderr, "register files: %d\n", ret);
+		return 1;
+	}
+	files[0] = -1;
+	ret = io_uring_register_files(dst, files, NR_SLOTS);
+	if (ret) {
+		fprintf(stderr, "register files: %d\n", ret);
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(src);
+	io_uring_prep_msg_ring_fd(sqe, dst->ring_fd, 0, 0, 3, 0);
+	sqe->user_data = 1;
+	io_uring_submit(src);
+	if (wait_one(src, 1, 0, 0) || wait_one(dst, 3, 0, 0))
+		return 1;
+
+	sqe = io_uring_get_sqe(src);
+	io_uring_prep_msg_ring_fd_alloc(sqe, dst->ring_fd, 0, 4, 0);
+	sqe->user_data = 1;
+	io_uring_submit(src);
+	/* slot 0 is taken now, so allocation must pick 1 */
+	if (wait_one(src, 1, 1, 0) || wait_one(dst, 4, 1, 0))
+		return 1;
+
+	/* both target slots now refer to the pipe */
+	for (i = 0; i < 2; i++) {
+		sqe = io_uring_get_sqe(dst);
+		io_uring_prep_write(sqe, i, "x", 1, 0);
+		sqe->flags |= IOSQE_FIXED_FILE;
+		sqe->user_data = 5;
+		io_uring_submit(dst);
+		if (wait_one(dst, 5, 1, 0))
+			return 1;
+	}
+	if (read(fds[0], buf, sizeof(buf)) != 2) {
+		fprintf(stderr, "pipe writes missing\n");
+		return 1;
+	}
+
+	io_uring_unregister_files(src);
+	io_uring_unregister_files(dst);
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+static int test_sync_msg(struct io_uring *dst)
+{
+	struct io_uring_sqe sqe;
+	int ret;
+
+	memset(&sqe, 0, sizeof(sqe));
+	io_uring_prep_msg_ring(&sqe, dst->ring_fd, 42, 7, 0);
+	ret = io_uring_register_sync_msg(&sqe);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Sync msg not supported, skipping\n");
+		return 0;
+	}
+	if (ret) {
+		fprintf(stderr, "sync msg: %d\n", ret);
+		return 1;
+	}
+	return wait_one(dst, 7, 42, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring src, dst;
+	int ret;
+
+	ret = io_uring_queue_init(8, &src, 0);
+	if (!ret)
+		ret = io_uring_queue_init(8, &dst, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = test_data(&src, &dst);
+	if (ret) {
+		fprintf(stderr, "test_data failed\n");
+		return ret;
+	}
+	if (no_msg_ring) {
+		fprintf(stdout, "MSG_RING not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_fd(&src, &dst);
+	if (ret) {
+		fprintf(stderr, "test_fd failed\n");
+		return ret;
+	}
+
+	ret = test_sync_msg(&dst);
+	if (ret) {
+		fprintf(stderr, "test_sync_msg failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&src);
+	io_uring_queue_exit(&dst);
+	return 0;
+}
@@ -85,16 +85,22 @@ err:
 	return 1;
 }
 
-int main(int argc, char *argv[])
+static int test(unsigned flags)
 {
 	struct io_uring ring;
 	int ret;
 
-	ret = io_uring_queue_init(8, &ring, 0);
+	ret = io_uring_queue_init(8, &ring, flags);
+	if (ret == -EINVAL && flags)
+		return 0;
 	if (ret) {
 		fprintf(stderr, "ring setup failed: %d\n", ret);
 		return 1;
 	}
+	if ((flags & IORING_SETUP_NO_SQARRAY) && ring.sq.array) {
+		fprintf(stderr, "SQ index array mapped\n");
+		return 1;
+	}
 
 	ret = test_single_nop(&ring);
 	if (ret) {
@@ -108,5 +114,25 @@ int main(int argc, char *argv[])
 		return ret;
 	}
 
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	ret = test(0);
+	if (ret) {
+		fprintf(stderr, "test failed\n");
+		return ret;
+	}
+
+	ret = test(IORING_SETUP_NO_SQARRAY);
+	if (ret) {
+		fprintf(stderr, "test NO_SQARRAY failed\n");
+		return ret;
+	}
+
 	return 0;
 }
@@ -0,0 +1,209 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test multishot poll, and updating the events and user_data
+ *		of an armed poll request in place
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include "liburing.h"
+
+#define POLL_DATA	1
+#define NEW_POLL_DATA	2
+#define UPDATE_DATA	3
+
+static int no_multishot;
+
+/*
+ * Reap 'nr' cqes, storing the poll cqe result and flags in 'res'/'flags' and
+ * checking that any other cqe is a successful update/remove
+ */
+static int reap(struct io_uring *ring, int nr, __u64 poll_data, int *res,
+		unsigned *flags)
+{
+	struct io_uring_cqe *cqe;
+	int ret, i;
+
+	*res = 0;
+	*flags = 0;
+	for (i = 0; i < nr; i++) {
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			return 1;
+		}
+		if (cqe->user_data == poll_data) {
+			*res = cqe->res;
+			*flags = cqe->flags;
+		} else if (cqe->user_data != UPDATE_DATA || cqe->res) {
+			fprintf(stderr, "cqe %llu: res %d\n",
+				(unsigned long long) cqe->user_data, cqe->res);
+			return 1;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+	return 0;
+}
+
+static int write_byte(int fd)
+{
+	char c = 'x';
+
+	if (write(fd, &c, 1) != 1) {
+		perror("write");
+		return 1;
+	}
+	return 0;
+}
+
+static int read_byte(int fd)
+{
+	char c;
+
+	if (read(fd, &c, 1) != 1) {
+		perror("read");
+		return 1;
+	}
+	return 0;
+}
+
+static int update(struct io_uring *ring, __u64 old_data, __u64 new_data,
+		  unsigned mask, unsigned flags)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_poll_update(sqe, (void *) (uintptr_t) old_data,
+				  (void *) (uintptr_t) new_data, mask, flags);
+	sqe->user_data = UPDATE_DATA;
+	return io_uring_submit(ring) != 1;
+}
+
+static int test(struct io_uring *ring)
+{
+	struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 10000000 };
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	unsigned flags;
+	int fds[2], i, res, ret;
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_poll_multishot(sqe, fds[0], POLLIN);
+	sqe->user_data = POLL_DATA;
+	io_uring_submit(ring);
+
+	/* one armed poll keeps triggering */
+	for (i = 0; i < 4; i++) {
+		if (write_byte(fds[1]))
+			return 1;
+		if (reap(ring, 1, POLL_DATA, &res, &flags))
+			return 1;
+		if (!i && (res == -EINVAL || !(flags & IORING_CQE_F_MORE))) {
+			no_multishot = 1;
+			goto out;
+		}
+		if (!(res & POLLIN) || !(flags & IORING_CQE_F_MORE)) {
+			fprintf(stderr, "poll %d: res %x flags %x\n", i, res,
+				flags);
+			return 1;
+		}
+		if (read_byte(fds[0]))
+			return 1;
+	}
+
+	/* move it to new user_data, which the next trigger must carry */
+	if (update(ring, POLL_DATA, NEW_POLL_DATA, 0,
+		   IORING_POLL_UPDATE_USER_DATA))
+		return 1;
+	if (reap(ring, 1, NEW_POLL_DATA, &res, &flags))
+		return 1;
+	if (write_byte(fds[1]))
+		return 1;
+	if (reap(ring, 1, NEW_POLL_DATA, &res, &flags))
+		return 1;
+	if (!(res & POLLIN) || !(flags & IORING_CQE_F_MORE)) {
+		fprintf(stderr, "updated poll: res %x flags %x\n", res, flags);
+		return 1;
+	}
+	if (read_byte(fds[0]))
+		return 1;
+
+	/* events that never trigger on a pipe read end, data must not wake */
+	if (update(ring, NEW_POLL_DATA, 0, POLLPRI,
+		   IORING_POLL_UPDATE_EVENTS | IORING_POLL_ADD_MULTI))
+		return 1;
+	if (reap(ring, 1, NEW_POLL_DATA, &res, &flags))
+		return 1;
+	if (write_byte(fds[1]))
+		return 1;
+	ret = io_uring_wait_cqe_timeout(ring, &cqe, &ts);
+	if (ret != -ETIME) {
+		fprintf(stderr, "poll triggered with no events: %d\n", ret);
+		return 1;
+	}
+
+	/* and back to POLLIN, which the pending data triggers right away */
+	if (update(ring, NEW_POLL_DATA, 0, POLLIN,
+		   IORING_POLL_UPDATE_EVENTS | IORING_POLL_ADD_MULTI))
+		return 1;
+	if (reap(ring, 2, NEW_POLL_DATA, &res, &flags))
+		return 1;
+	if (!(res & POLLIN) || !(flags & IORING_CQE_F_MORE)) {
+		fprintf(stderr, "re-evented poll: res %x flags %x\n", res,
+			flags);
+		return 1;
+	}
+	if (read_byte(fds[0]))
+		return 1;
+
+	/* removal posts the final cqe, without IORING_CQE_F_MORE */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_poll_remove(sqe, (void *) (uintptr_t) NEW_POLL_DATA);
+	sqe->user_data = UPDATE_DATA;
+	io_uring_submit(ring);
+	if (reap(ring, 2, NEW_POLL_DATA, &res, &flags))
+		return 1;
+	if (res != -ECANCELED || (flags & IORING_CQE_F_MORE)) {
+		fprintf(stderr, "removed poll: res %d flags %x\n", res, flags);
+		return 1;
+	}
+out:
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = test(&ring);
+	if (ret) {
+		fprintf(stderr, "test failed\n");
+		return ret;
+	}
+	if (no_multishot) {
+		fprintf(stdout, "Multishot poll not supported, skipping\n");
+		return 0;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
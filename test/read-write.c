@@ -17,6 +17,7 @@
 #define FILE_SIZE	(128 * 1024)
 #define BS		4096
 #define BUFFERS		(FILE_SIZE / BS)
+#define VEC_NR		4
 
 static struct iovec *vecs;
 static int no_read;
@@ -669,6 +670,150 @@ err:
 	return 1;
 }
 
+/*
+ * Write the file with vectored fixed writes, each request gathering VEC_NR
+ * blocks from scattered places of one registered buffer, then read it back
+ * the same way into the other half of that buffer
+ */
+static int test_vec_fixed(const char *file, int buffered)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	struct io_uring ring;
+	struct iovec reg, *iovs;
+	int i, j, fd, ret, open_flags, nr_reqs = BUFFERS / VEC_NR;
+	unsigned char *buf;
+
+	ret = io_uring_queue_init(64, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring create failed: %d\n", ret);
+		return 1;
+	}
+
+	open_flags = O_RDWR;
+	if (!buffered)
+		open_flags |= O_DIRECT;
+	fd = open(file, open_flags);
+	if (fd < 0) {
+		perror("file open");
+		return 1;
+	}
+
+	if (posix_memalign((void **) &buf, BS, 2 * FILE_SIZE))
+		return 1;
+	for (i = 0; i < BUFFERS; i++)
+		memset(buf + i * BS, i, BS);
+	memset(buf + FILE_SIZE, 0x55, FILE_SIZE);
+	reg.iov_base = buf;
+	reg.iov_len = 2 * FILE_SIZE;
+	ret = io_uring_register_buffers(&ring, &reg, 1);
+	if (ret) {
+		fprintf(stderr, "buffer reg failed: %d\n", ret);
+		return 1;
+	}
+
+	/*
+	 * Request i covers file blocks i * VEC_NR and on, gathered from the
+	 * blocks nr_reqs apart starting at block i of the buffer
+	 */
+	iovs = calloc(BUFFERS, sizeof(struct iovec));
+	for (i = 0; i < nr_reqs; i++) {
+		for (j = 0; j < VEC_NR; j++) {
+			iovs[i * VEC_NR + j].iov_base = buf + (i + j * nr_reqs) * BS;
+			iovs[i * VEC_NR + j].iov_len = BS;
+		}
+		sqe = io_uring_get_sqe(&ring);
+		io_uring_prep_writev_fixed(sqe, fd, &iovs[i * VEC_NR], VEC_NR,
+						i * VEC_NR * BS, 0, 0);
+	}
+	ret = io_uring_submit_and_wait(&ring, nr_reqs);
+	if (ret != nr_reqs) {
+		fprintf(stderr, "submit got %d, wanted %d\n", ret, nr_reqs);
+		return 1;
+	}
+	for (i = 0; i < nr_reqs; i++) {
+		ret = io_uring_wait_cqe(&ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait_cqe=%d\n", ret);
+			return 1;
+		}
+		if (cqe->res != VEC_NR * BS) {
+			fprintf(stderr, "writev_fixed res %d\n", cqe->res);
+			return 1;
+		}
+		io_uring_cqe_seen(&ring, cqe);
+	}
+
+	for (i = 0; i < BUFFERS; i++)
+		iovs[i].iov_base = (unsigned char *) iovs[i].iov_base + FILE_SIZE;
+	for (i = 0; i < nr_reqs; i++) {
+		sqe = io_uring_get_sqe(&ring);
+		io_uring_prep_readv_fixed(sqe, fd, &iovs[i * VEC_NR], VEC_NR,
+						i * VEC_NR * BS, 0, 0);
+	}
+	ret = io_uring_submit_and_wait(&ring, nr_reqs);
+	if (ret != nr_reqs) {
+		fprintf(stderr, "submit got %d, wanted %d\n", ret, nr_reqs);
+		return 1;
+	}
+	for (i = 0; i < nr_reqs; i++) {
+		ret = io_uring_wait_cqe(&ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait_cqe=%d\n", ret);
+			return 1;
+		}
+		if (cqe->res != VEC_NR * BS) {
+			fprintf(stderr, "readv_fixed res %d\n", cqe->res);
+			return 1;
+		}
+		io_uring_cqe_seen(&ring, cqe);
+	}
+	if (memcmp(buf, buf + FILE_SIZE, FILE_SIZE)) {
+		fprintf(stderr, "vectored fixed data mismatch\n");
+		return 1;
+	}
+
+	/* an iovec outside the registered buffer fails the request */
+	iovs[0].iov_base = vecs[0].iov_base;
+	sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_readv_fixed(sqe, fd, iovs, VEC_NR, 0, 0, 0);
+	ret = io_uring_submit_and_wait(&ring, 1);
+	if (ret != 1) {
+		fprintf(stderr, "submit got %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_wait_cqe(&ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait_cqe=%d\n", ret);
+		return 1;
+	}
+	if (cqe->res != -EFAULT) {
+		fprintf(stderr, "readv_fixed outside buffer res %d\n", cqe->res);
+		return 1;
+	}
+	io_uring_cqe_seen(&ring, cqe);
+
+	io_uring_queue_exit(&ring);
+	close(fd);
+	free(iovs);
+	free(buf);
+	return 0;
+}
+
+static int has_vec_fixed(void)
+{
+	struct io_uring_probe *p;
+	int ret;
+
+	p = io_uring_get_probe();
+	if (!p)
+		return 0;
+	ret = io_uring_opcode_supported(p, IORING_OP_READV_FIXED) &&
+		io_uring_opcode_supported(p, IORING_OP_WRITEV_FIXED);
+	free(p);
+	return ret;
+}
+
 int main(int argc, char *argv[])
 {
 	int i, ret, nr;
@@ -747,6 +892,18 @@ int main(int argc, char *argv[])
 		goto err;
 	}
 
+	if (has_vec_fixed()) {
+		for (i = 0; i < 2; i++) {
+			ret = test_vec_fixed(".basic-rw", i);
+			if (ret) {
+				fprintf(stderr, "test_vec_fixed %d failed\n", i);
+				goto err;
+			}
+		}
+	} else {
+		fprintf(stdout, "Vectored fixed IO not supported, skipping\n");
+	}
+
 	ret = test_write_efbig();
 	if (ret) {
 		fprintf(stderr, "test_write_efbig failed\n");
@@ -0,0 +1,308 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test multishot recv and recvmsg with buffers selected from a
+ *		provided buffer ring, and parsing the recvmsg output
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "liburing.h"
+
+#define BGID		1
+#define NR_BUFS		16
+#define BUF_SIZE	256
+#define NR_MSGS		(2 * NR_BUFS)
+
+static char bufs[NR_BUFS][BUF_SIZE];
+static int no_multishot;
+
+static struct io_uring_buf_ring *setup_bufs(struct io_uring *ring)
+{
+	struct io_uring_buf_ring *br;
+	int ret, i;
+
+	br = io_uring_setup_buf_ring(ring, NR_BUFS, BGID, 0, &ret);
+	if (!br) {
+		fprintf(stderr, "setup buf ring: %d\n", ret);
+		return NULL;
+	}
+	for (i = 0; i < NR_BUFS; i++)
+		io_uring_buf_ring_add(br, bufs[i], BUF_SIZE, i,
+				      io_uring_buf_ring_mask(NR_BUFS), i);
+	io_uring_buf_ring_advance(br, NR_BUFS);
+	return br;
+}
+
+/*
+ * Wait for the next cqe of the multishot request, and return the buffer
+ * it used in 'bid'
+ */
+static int wait_buf_cqe(struct io_uring *ring, struct io_uring_cqe **cqe,
+			int *bid)
+{
+	int ret;
+
+	ret = io_uring_wait_cqe(ring, cqe);
+	if (ret) {
+		fprintf(stderr, "wait cqe: %d\n", ret);
+		return 1;
+	}
+	if ((*cqe)->res < 0)
+		return 0;
+	if (!((*cqe)->flags & IORING_CQE_F_BUFFER)) {
+		fprintf(stderr, "no buffer selected, res %d\n", (*cqe)->res);
+		return 1;
+	}
+	*bid = (*cqe)->flags >> IORING_CQE_BUFFER_SHIFT;
+	return 0;
+}
+
+static void recycle_buf(struct io_uring *ring, struct io_uring_buf_ring *br,
+			int bid)
+{
+	io_uring_buf_ring_add(br, bufs[bid], BUF_SIZE, bid,
+			      io_uring_buf_ring_mask(NR_BUFS), 0);
+	io_uring_buf_ring_cq_advance(ring, br, 1);
+}
+
+static int test_recv(struct io_uring *ring, struct io_uring_buf_ring *br)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	int fds[2], i, bid, ret;
+	char msg[32];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_recv_multishot(sqe, fds[0], NULL, 0, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BGID;
+	sqe->user_data = 1;
+	io_uring_submit(ring);
+
+	/* more messages than buffers, so they must get recycled */
+	for (i = 0; i < NR_MSGS; i++) {
+		memset(msg, 'a' + i, sizeof(msg));
+		if (write(fds[1], msg, sizeof(msg)) != sizeof(msg)) {
+			perror("write");
+			return 1;
+		}
+
+		if (wait_buf_cqe(ring, &cqe, &bid))
+			return 1;
+		if (cqe->res == -EINVAL && !i) {
+			no_multishot = 1;
+			io_uring_cqe_seen(ring, cqe);
+			goto out;
+		}
+		if (cqe->res != sizeof(msg) || !io_uring_cqe_more(cqe)) {
+			fprintf(stderr, "recv %d: res %d flags %x\n", i,
+				cqe->res, cqe->flags);
+			return 1;
+		}
+		if (memcmp(bufs[bid], msg, sizeof(msg))) {
+			fprintf(stderr, "bad recv data\n");
+			return 1;
+		}
+		recycle_buf(ring, br, bid);
+	}
+
+	/* EOF terminates the multishot */
+	close(fds[1]);
+	ret = io_uring_wait_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait cqe: %d\n", ret);
+		return 1;
+	}
+	if (cqe->res || io_uring_cqe_more(cqe)) {
+		fprintf(stderr, "eof: res %d flags %x\n", cqe->res, cqe->flags);
+		return 1;
+	}
+	io_uring_cqe_seen(ring, cqe);
+	close(fds[0]);
+	return 0;
+out:
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+static int udp_socket(struct sockaddr_in *addr)
+{
+	socklen_t addrlen = sizeof(*addr);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *) addr, sizeof(*addr)) < 0 ||
+	    getsockname(fd, (struct sockaddr *) addr, &addrlen) < 0) {
+		perror("bind");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int test_recvmsg(struct io_uring *ring, struct io_uring_buf_ring *br)
+{
+	struct sockaddr_in rx_addr, tx_addr, *name;
+	struct io_uring_recvmsg_out *o;
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	int rx, tx, i, bid, ret, val = 1;
+	char data[64];
+
+	rx = udp_socket(&rx_addr);
+	tx = udp_socket(&tx_addr);
+	if (rx < 0 || tx < 0)
+		return 1;
+	if (setsockopt(rx, IPPROTO_IP, IP_PKTINFO, &val, sizeof(val)) < 0) {
+		perror("setsockopt");
+		return 1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_namelen = sizeof(struct sockaddr_in);
+	msg.msg_controllen = CMSG_SPACE(sizeof(struct in_pktinfo));
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_recvmsg_multishot(sqe, rx, &msg, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BGID;
+	sqe->user_data = 1;
+	io_uring_submit(ring);
+
+	for (i = 0; i < NR_MSGS; i++) {
+		/* vary the size, to check the payload length */
+		memset(data, 'A' + i, sizeof(data));
+		ret = sendto(tx, data, i + 1, 0, (struct sockaddr *) &rx_addr,
+				sizeof(rx_addr));
+		if (ret != i + 1) {
+			perror("sendto");
+			return 1;
+		}
+
+		if (wait_buf_cqe(ring, &cqe, &bid))
+			return 1;
+		if (cqe->res < 0 || !io_uring_cqe_more(cqe)) {
+			fprintf(stderr, "recvmsg %d: res %d flags %x\n", i,
+				cqe->res, cqe->flags);
+			return 1;
+		}
+
+		o = io_uring_recvmsg_validate(bufs[bid], cqe->res, &msg);
+		if (!o) {
+			fprintf(stderr, "invalid recvmsg output\n");
+			return 1;
+		}
+		if (o->namelen != sizeof(*name) || o->payloadlen != i + 1 ||
+		    o->flags & MSG_TRUNC) {
+			fprintf(stderr, "namelen %u payloadlen %u flags %x\n",
+				o->namelen, o->payloadlen, o->flags);
+			return 1;
+		}
+		name = io_uring_recvmsg_name(o);
+		if (name->sin_port != tx_addr.sin_port) {
+			fprintf(stderr, "wrong sender port\n");
+			return 1;
+		}
+		cmsg = io_uring_recvmsg_cmsg_firsthdr(o, &msg);
+		if (!cmsg || cmsg->cmsg_level != IPPROTO_IP ||
+		    cmsg->cmsg_type != IP_PKTINFO) {
+			fprintf(stderr, "missing pktinfo cmsg\n");
+			return 1;
+		}
+		if (io_uring_recvmsg_cmsg_nexthdr(o, &msg, cmsg)) {
+			fprintf(stderr, "unexpected second cmsg\n");
+			return 1;
+		}
+		if (io_uring_recvmsg_payload_length(o, cqe->res, &msg) != i + 1 ||
+		    memcmp(io_uring_recvmsg_payload(o, &msg), data, i + 1)) {
+			fprintf(stderr, "bad recvmsg payload\n");
+			return 1;
+		}
+		recycle_buf(ring, br, bid);
+	}
+
+	/* cancel, the final cqe must not have F_MORE set */
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_cancel(sqe, (void *) 1, 0);
+	sqe->user_data = 2;
+	io_uring_submit(ring);
+
+	for (i = 0; i < 2; i++) {
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			return 1;
+		}
+		if (cqe->user_data == 1 &&
+		    (cqe->res != -ECANCELED || io_uring_cqe_more(cqe))) {
+			fprintf(stderr, "cancelled: res %d flags %x\n",
+				cqe->res, cqe->flags);
+			return 1;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+
+	close(rx);
+	close(tx);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring_buf_ring *br;
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(32, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	br = setup_bufs(&ring);
+	if (!br) {
+		fprintf(stdout, "Buffer rings not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_recv(&ring, br);
+	if (ret) {
+		fprintf(stderr, "test_recv failed\n");
+		return ret;
+	}
+	if (no_multishot) {
+		fprintf(stdout, "Multishot recv not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_recvmsg(&ring, br);
+	if (ret) {
+		fprintf(stderr, "test_recvmsg failed\n");
+		return ret;
+	}
+
+	io_uring_free_buf_ring(&ring, br, NR_BUFS, BGID);
+	io_uring_queue_exit(&ring);
+	return 0;
+}
@@ -0,0 +1,314 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test bundle recv and send, which fill or drain several
+ *		provided buffers with a single request, and walking the
+ *		buffers a bundle completion used
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "liburing.h"
+
+#define RECV_BGID	1
+#define SEND_BGID	2
+#define NR_BUFS		16
+#define BUF_SIZE	64
+
+static char recv_bufs[NR_BUFS][BUF_SIZE];
+static char send_bufs[NR_BUFS][BUF_SIZE];
+
+static struct io_uring_buf_ring *setup_bufs(struct io_uring *ring, int bgid,
+					    char bufs[][BUF_SIZE], int nr)
+{
+	struct io_uring_buf_ring *br;
+	int ret, i;
+
+	br = io_uring_setup_buf_ring(ring, NR_BUFS, bgid, 0, &ret);
+	if (!br) {
+		fprintf(stderr, "setup buf ring: %d\n", ret);
+		return NULL;
+	}
+	for (i = 0; i < nr; i++)
+		io_uring_buf_ring_add(br, bufs[i], BUF_SIZE, i,
+				      io_uring_buf_ring_mask(NR_BUFS), i);
+	io_uring_buf_ring_advance(br, nr);
+	return br;
+}
+
+/*
+ * Wait for a bundle completion, and check it started at the ring index
+ * 'head' we've tracked. Returns the bytes transferred, or -1 on error.
+ */
+static int wait_bundle(struct io_uring *ring, struct io_uring_buf_ring *br,
+		       unsigned short head)
+{
+	struct io_uring_cqe *cqe;
+	int ret, bid;
+
+	ret = io_uring_wait_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait cqe: %d\n", ret);
+		return -1;
+	}
+	if (cqe->res <= 0 || !(cqe->flags & IORING_CQE_F_BUFFER)) {
+		fprintf(stderr, "bundle: res %d flags %x\n", cqe->res,
+			cqe->flags);
+		return -1;
+	}
+	bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	if (bid != io_uring_buf_ring_entry(br, io_uring_buf_ring_mask(NR_BUFS),
+					   head)->bid) {
+		fprintf(stderr, "bundle started at bid %d\n", bid);
+		return -1;
+	}
+	ret = cqe->res;
+	io_uring_cqe_seen(ring, cqe);
+	return ret;
+}
+
+/*
+ * Receive 'len' bytes into bundles of buffers starting at ring index
+ * '*head', check the data and hand the buffers back. The kernel may not
+ * grab every buffer at once, so this can take more than one recv.
+ */
+static int recv_bundle(struct io_uring *ring, struct io_uring_buf_ring *br,
+		       int fds[2], unsigned short *head, int len, char c)
+{
+	int mask = io_uring_buf_ring_mask(NR_BUFS);
+	struct io_uring_sqe *sqe;
+	char data[NR_BUFS * BUF_SIZE];
+	unsigned nr, i;
+	int left, res;
+
+	memset(data, c, len);
+	if (write(fds[1], data, len) != len) {
+		perror("write");
+		return 1;
+	}
+
+	for (left = len; left; left -= res) {
+		int buf_left;
+
+		sqe = io_uring_get_sqe(ring);
+		io_uring_prep_recv_bundle(sqe, fds[0], 0, 0);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = RECV_BGID;
+		io_uring_submit(ring);
+		res = wait_bundle(ring, br, *head);
+		if (res < 0 || res > left)
+			return 1;
+
+		nr = io_uring_buf_ring_bundle_nr(br, mask, *head, res);
+		if (nr != (res + BUF_SIZE - 1) / BUF_SIZE) {
+			fprintf(stderr, "recv of %d used %u bufs\n", res, nr);
+			return 1;
+		}
+		buf_left = res;
+		for (i = 0; i < nr; i++) {
+			struct io_uring_buf *buf;
+			int this_len;
+
+			buf = io_uring_buf_ring_entry(br, mask, *head + i);
+			this_len = buf_left < buf->len ? buf_left : buf->len;
+			if (memcmp((void *) (uintptr_t) buf->addr, data,
+				   this_len)) {
+				fprintf(stderr, "bad data in buf %d\n",
+					buf->bid);
+				return 1;
+			}
+			buf_left -= this_len;
+			io_uring_buf_ring_add(br, recv_bufs[buf->bid],
+					      BUF_SIZE, buf->bid, mask, i);
+		}
+		io_uring_buf_ring_advance(br, nr);
+		*head += nr;
+	}
+	return 0;
+}
+
+static int test_recv(struct io_uring *ring)
+{
+	struct io_uring_buf_ring *br;
+	unsigned short head = 0;
+	int fds[2], i;
+
+	br = setup_bufs(ring, RECV_BGID, recv_bufs, NR_BUFS);
+	if (!br)
+		return 1;
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	/* enough rounds to wrap the buffer ring a few times */
+	for (i = 0; i < 8; i++) {
+		if (recv_bundle(ring, br, fds, &head, 5 * BUF_SIZE - 20,
+				'a' + i))
+			return 1;
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	return io_uring_free_buf_ring(ring, br, NR_BUFS, RECV_BGID);
+}
+
+static int send_bundle(struct io_uring *ring, struct io_uring_buf_ring *br,
+		       int fds[2], unsigned short head)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_send_bundle(sqe, fds[1], 0, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = SEND_BGID;
+	io_uring_submit(ring);
+	return wait_bundle(ring, br, head);
+}
+
+/*
+ * A zero length buffer in the middle of a send bundle is consumed along with
+ * the rest. Called with the first five buffers of the ring already sent.
+ */
+static int test_send_zero_len(struct io_uring *ring,
+			      struct io_uring_buf_ring *br, int fds[2])
+{
+	int mask = io_uring_buf_ring_mask(NR_BUFS);
+	static const int lens[] = { 10, 0, 20 };
+	char expect[NR_BUFS * BUF_SIZE], got[NR_BUFS * BUF_SIZE];
+	unsigned short head = 5;
+	int i, ret, len = 0;
+
+	for (i = 0; i < 3; i++) {
+		memset(send_bufs[head + i], 'F' + i, lens[i]);
+		memcpy(expect + len, send_bufs[head + i], lens[i]);
+		io_uring_buf_ring_add(br, send_bufs[head + i], lens[i],
+				      head + i, mask, i);
+		len += lens[i];
+	}
+	io_uring_buf_ring_advance(br, 3);
+
+	ret = send_bundle(ring, br, fds, head);
+	if (ret != len) {
+		fprintf(stderr, "zero len bundle sent %d of %d\n", ret, len);
+		return 1;
+	}
+	if (io_uring_buf_ring_bundle_nr(br, mask, head, len) != 3) {
+		fprintf(stderr, "zero len bundle used %u bufs\n",
+			io_uring_buf_ring_bundle_nr(br, mask, head, len));
+		return 1;
+	}
+	head += 3;
+
+	/* the next bundle must start after the zero length buffer */
+	memset(send_bufs[head], 'Z', 10);
+	memcpy(expect + len, send_bufs[head], 10);
+	io_uring_buf_ring_add(br, send_bufs[head], 10, head, mask, 0);
+	io_uring_buf_ring_advance(br, 1);
+	ret = send_bundle(ring, br, fds, head);
+	if (ret != 10) {
+		fprintf(stderr, "bundle after zero len sent %d\n", ret);
+		return 1;
+	}
+
+	ret = recv(fds[0], got, sizeof(got), MSG_WAITALL | MSG_DONTWAIT);
+	if (ret != len + 10 || memcmp(got, expect, len + 10)) {
+		fprintf(stderr, "got %d bytes after zero len bundle\n", ret);
+		return 1;
+	}
+
+	/* more data than the ring holds stops after one pass of the ring */
+	if (io_uring_buf_ring_bundle_nr(br, mask, 0, NR_BUFS * BUF_SIZE * 4) !=
+	    NR_BUFS) {
+		fprintf(stderr, "bundle_nr went past the ring\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int test_send(struct io_uring *ring)
+{
+	int mask = io_uring_buf_ring_mask(NR_BUFS);
+	struct io_uring_buf_ring *br;
+	char expect[NR_BUFS * BUF_SIZE], got[NR_BUFS * BUF_SIZE];
+	int fds[2], i, len = 0, ret;
+
+	br = setup_bufs(ring, SEND_BGID, send_bufs, 0);
+	if (!br)
+		return 1;
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	/* queue up buffers of differing lengths, one send drains them all */
+	for (i = 0; i < 5; i++) {
+		int this_len = (i + 1) * 10;
+
+		memset(send_bufs[i], 'A' + i, this_len);
+		memcpy(expect + len, send_bufs[i], this_len);
+		io_uring_buf_ring_add(br, send_bufs[i], this_len, i, mask, i);
+		len += this_len;
+	}
+	io_uring_buf_ring_advance(br, 5);
+
+	ret = send_bundle(ring, br, fds, 0);
+	if (ret != len) {
+		fprintf(stderr, "sent %d of %d\n", ret, len);
+		return 1;
+	}
+	if (io_uring_buf_ring_bundle_nr(br, mask, 0, len) != 5) {
+		fprintf(stderr, "send used %u bufs\n",
+			io_uring_buf_ring_bundle_nr(br, mask, 0, len));
+		return 1;
+	}
+
+	ret = recv(fds[0], got, sizeof(got), MSG_WAITALL | MSG_DONTWAIT);
+	if (ret != len || memcmp(got, expect, len)) {
+		fprintf(stderr, "bad send data, %d bytes\n", ret);
+		return 1;
+	}
+
+	ret = test_send_zero_len(ring, br, fds);
+	if (ret)
+		return ret;
+
+	close(fds[0]);
+	close(fds[1]);
+	return io_uring_free_buf_ring(ring, br, NR_BUFS, SEND_BGID);
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	if (!(ring.features & IORING_FEAT_RECVSEND_BUNDLE)) {
+		fprintf(stdout, "Bundles not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_recv(&ring);
+	if (ret) {
+		fprintf(stderr, "test_recv failed\n");
+		return ret;
+	}
+
+	ret = test_send(&ring);
+	if (ret) {
+		fprintf(stderr, "test_send failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test submitting and reaping through a registered ring fd
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "liburing.h"
+
+static int test_nops(struct io_uring *ring, int nr)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	struct __kernel_timespec ts = { .tv_sec = 1, };
+	int i, ret;
+
+	for (i = 0; i < nr; i++) {
+		sqe = io_uring_get_sqe(ring);
+		if (!sqe) {
+			fprintf(stderr, "get sqe failed\n");
+			goto err;
+		}
+		io_uring_prep_nop(sqe);
+		sqe->user_data = i + 1;
+	}
+
+	ret = io_uring_submit_and_wait(ring, 1);
+	if (ret != nr) {
+		fprintf(stderr, "submitted %d, wanted %d\n", ret, nr);
+		goto err;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ret = io_uring_wait_cqe_timeout(ring, &cqe, &ts);
+		if (ret < 0) {
+			fprintf(stderr, "wait completion %d\n", ret);
+			goto err;
+		}
+		if (cqe->res) {
+			fprintf(stderr, "nop res %d\n", cqe->res);
+			goto err;
+		}
+		io_uring_cqe_seen(ring, cqe);
+	}
+
+	return 0;
+err:
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_register_ring_fd(&ring);
+	if (ret == -EINVAL) {
+		fprintf(stdout, "Ring fd registration not supported, skipping\n");
+		return 0;
+	} else if (ret != 1) {
+		fprintf(stderr, "ring fd register: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_register_ring_fd(&ring);
+	if (ret != -EEXIST) {
+		fprintf(stderr, "double ring fd register: %d\n", ret);
+		return 1;
+	}
+
+	if (test_nops(&ring, 4)) {
+		fprintf(stderr, "registered nops failed\n");
+		return 1;
+	}
+
+	ret = io_uring_unregister_ring_fd(&ring);
+	if (ret != 1) {
+		fprintf(stderr, "ring fd unregister: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_unregister_ring_fd(&ring);
+	if (ret != -EINVAL) {
+		fprintf(stderr, "double ring fd unregister: %d\n", ret);
+		return 1;
+	}
+
+	if (test_nops(&ring, 4)) {
+		fprintf(stderr, "unregistered nops failed\n");
+		return 1;
+	}
+
+	/* exit with the ring fd still registered */
+	ret = io_uring_register_ring_fd(&ring);
+	if (ret != 1) {
+		fprintf(stderr, "ring fd re-register: %d\n", ret);
+		return 1;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
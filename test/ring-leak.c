@@ -8,6 +8,7 @@
  * https://lore.kernel.org/linux-block/20190129192702.3605-1-axboe@kernel.dk/T/#m6c87fc64e4d063786af6ec6fadce3ac1e95d3184
  *
  */
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -41,6 +42,7 @@ static int get_ring_fd(void)
 
 	fd = __sys_io_uring_setup(2, &p);
 	if (fd < 0) {
+		errno = -fd;
 		perror("io_uring_setup");
 		return -1;
 	}
@@ -88,6 +90,7 @@ int main(int argc, char *argv[])
 
 	ret = __io_uring_register_files(ring_fd, sp[0], sp[1]);
 	if (ret < 0) {
+		errno = -ret;
 		perror("register files");
 		return 1;
 	}
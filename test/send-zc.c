@@ -0,0 +1,249 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test zero-copy send, sendmsg and fixed buffer send, and the
+ *		result plus notification CQE lifecycle
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "liburing.h"
+
+#define SEND_SIZE	8192
+
+static char tx_buf[SEND_SIZE];
+static char rx_buf[SEND_SIZE];
+static int no_send_zc;
+
+static int tcp_pair(int fds[2])
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int listen_fd;
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (listen_fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    listen(listen_fd, 1) < 0 ||
+	    getsockname(listen_fd, (struct sockaddr *) &addr, &addrlen) < 0) {
+		perror("bind/listen");
+		return 1;
+	}
+
+	fds[1] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (fds[1] < 0 ||
+	    connect(fds[1], (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("connect");
+		return 1;
+	}
+	fds[0] = accept(listen_fd, NULL, NULL);
+	if (fds[0] < 0) {
+		perror("accept");
+		return 1;
+	}
+	close(listen_fd);
+	return 0;
+}
+
+/*
+ * Reap the result and notification CQEs of one zero-copy send, and check
+ * the data made it to the other end
+ */
+static int reap_send(struct io_uring *ring, int rx_fd, int len)
+{
+	struct io_uring_cqe *cqe;
+	int ret, got, done = 0, nr = 0;
+
+	while (!done) {
+		ret = io_uring_wait_cqe(ring, &cqe);
+		if (ret) {
+			fprintf(stderr, "wait cqe: %d\n", ret);
+			return 1;
+		}
+		if (!nr && cqe->res == -EINVAL) {
+			no_send_zc = 1;
+			io_uring_cqe_seen(ring, cqe);
+			return 0;
+		}
+		if (!nr) {
+			/* the send result, the notification must follow */
+			if (cqe->res != len || io_uring_cqe_notif(cqe) ||
+			    !io_uring_cqe_more(cqe)) {
+				fprintf(stderr, "send: res %d flags %x\n",
+					cqe->res, cqe->flags);
+				return 1;
+			}
+		} else if (!io_uring_cqe_notif(cqe) ||
+			   (cqe->res & ~IORING_NOTIF_USAGE_ZC_COPIED)) {
+			fprintf(stderr, "notif: res %x flags %x\n", cqe->res,
+				cqe->flags);
+			return 1;
+		}
+		if (cqe->user_data != 1) {
+			fprintf(stderr, "bad user_data %llu\n",
+				(unsigned long long) cqe->user_data);
+			return 1;
+		}
+		done = io_uring_send_zc_buf_done(cqe);
+		io_uring_cqe_seen(ring, cqe);
+		nr++;
+	}
+	if (nr != 2) {
+		fprintf(stderr, "got %d cqes\n", nr);
+		return 1;
+	}
+
+	for (got = 0; got < len; got += ret) {
+		ret = recv(rx_fd, rx_buf + got, len - got, 0);
+		if (ret <= 0) {
+			perror("recv");
+			return 1;
+		}
+	}
+	if (memcmp(rx_buf, tx_buf, len)) {
+		fprintf(stderr, "data mismatch\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int test_send_zc(struct io_uring *ring, int fds[2], int fixed)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(ring);
+	if (fixed)
+		io_uring_prep_send_zc_fixed(sqe, fds[1], tx_buf, SEND_SIZE, 0,
+					    IORING_SEND_ZC_REPORT_USAGE, 0);
+	else
+		io_uring_prep_send_zc(sqe, fds[1], tx_buf, SEND_SIZE, 0,
+				      IORING_SEND_ZC_REPORT_USAGE);
+	sqe->user_data = 1;
+	io_uring_submit(ring);
+	return reap_send(ring, fds[0], SEND_SIZE);
+}
+
+static int test_sendmsg_zc(struct io_uring *ring, int fds[2])
+{
+	struct io_uring_sqe *sqe;
+	struct iovec iov[2];
+	struct msghdr msg;
+
+	iov[0].iov_base = tx_buf;
+	iov[0].iov_len = SEND_SIZE / 2;
+	iov[1].iov_base = tx_buf + SEND_SIZE / 2;
+	iov[1].iov_len = SEND_SIZE / 2;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_sendmsg_zc(sqe, fds[1], &msg, 0);
+	sqe->user_data = 1;
+	io_uring_submit(ring);
+	return reap_send(ring, fds[0], SEND_SIZE);
+}
+
+/* unconnected UDP, with the destination passed in the sqe */
+static int test_send_zc_addr(struct io_uring *ring)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	struct io_uring_sqe *sqe;
+	int rx, tx, ret;
+
+	rx = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	tx = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (rx < 0 || tx < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(rx, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    getsockname(rx, (struct sockaddr *) &addr, &addrlen) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_send_zc(sqe, tx, tx_buf, 1024, 0, 0);
+	io_uring_prep_send_set_addr(sqe, (struct sockaddr *) &addr,
+				    sizeof(addr));
+	sqe->user_data = 1;
+	io_uring_submit(ring);
+	ret = reap_send(ring, rx, 1024);
+	close(rx);
+	close(tx);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	struct iovec iov;
+	int fds[2], ret, i;
+
+	for (i = 0; i < SEND_SIZE; i++)
+		tx_buf[i] = i;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	if (tcp_pair(fds))
+		return 1;
+
+	ret = test_send_zc(&ring, fds, 0);
+	if (ret) {
+		fprintf(stderr, "test_send_zc failed\n");
+		return ret;
+	}
+	if (no_send_zc) {
+		fprintf(stdout, "Zero-copy send not supported, skipping\n");
+		return 0;
+	}
+
+	iov.iov_base = tx_buf;
+	iov.iov_len = SEND_SIZE;
+	ret = io_uring_register_buffers(&ring, &iov, 1);
+	if (ret) {
+		fprintf(stderr, "register buffers: %d\n", ret);
+		return 1;
+	}
+	ret = test_send_zc(&ring, fds, 1);
+	if (ret) {
+		fprintf(stderr, "test_send_zc fixed failed\n");
+		return ret;
+	}
+
+	ret = test_sendmsg_zc(&ring, fds);
+	if (ret) {
+		fprintf(stderr, "test_sendmsg_zc failed\n");
+		return ret;
+	}
+
+	ret = test_send_zc_addr(&ring);
+	if (ret) {
+		fprintf(stderr, "test_send_zc_addr failed\n");
+		return ret;
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	io_uring_queue_exit(&ring);
+	return 0;
+}
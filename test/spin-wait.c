@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test waiting for completions with the ring set to spin
+ *		before sleeping, for completions that arrive within and
+ *		after the spin budget
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liburing.h"
+
+#define SPIN_USEC	200
+
+static int wait_timeout(struct io_uring *ring, unsigned long long nsec,
+			__u64 user_data)
+{
+	struct __kernel_timespec ts = { .tv_nsec = nsec, };
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	int ret;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_timeout(sqe, &ts, 0, 0);
+	sqe->user_data = user_data;
+	ret = io_uring_submit(ring);
+	if (ret != 1) {
+		fprintf(stderr, "submit: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_wait_cqe(ring, &cqe);
+	if (ret) {
+		fprintf(stderr, "wait: %d\n", ret);
+		return 1;
+	}
+	if (cqe->user_data != user_data || cqe->res != -ETIME) {
+		fprintf(stderr, "bad cqe %llu res %d\n",
+			(unsigned long long) cqe->user_data, cqe->res);
+		return 1;
+	}
+	io_uring_cqe_seen(ring, cqe);
+	return 0;
+}
+
+static int wait_nops(struct io_uring *ring, unsigned nr)
+{
+	struct io_uring_cqe *cqe;
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < nr; i++)
+		io_uring_prep_nop(io_uring_get_sqe(ring));
+	ret = io_uring_submit(ring);
+	if (ret != nr) {
+		fprintf(stderr, "submit: %d\n", ret);
+		return 1;
+	}
+
+	ret = io_uring_wait_cqe_nr(ring, &cqe, nr);
+	if (ret) {
+		fprintf(stderr, "wait nr: %d\n", ret);
+		return 1;
+	}
+	if (io_uring_cq_ready(ring) != nr) {
+		fprintf(stderr, "got %u cqes\n", io_uring_cq_ready(ring));
+		return 1;
+	}
+	io_uring_cq_advance(ring, nr);
+	return 0;
+}
+
+static int test_spin(unsigned flags)
+{
+	struct io_uring ring;
+	int ret, i;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_set_spin_wait(&ring, SPIN_USEC, flags);
+	if (ret) {
+		fprintf(stderr, "set spin wait: %d\n", ret);
+		return 1;
+	}
+
+	if (wait_nops(&ring, 4))
+		return 1;
+
+	/* within the budget, then well past it, then within again */
+	for (i = 0; i < 4; i++) {
+		if (wait_timeout(&ring, 50000, 1))
+			return 1;
+	}
+	for (i = 0; i < 4; i++) {
+		if (wait_timeout(&ring, 5000000, 2))
+			return 1;
+	}
+	if ((flags & LIBURING_SPIN_ADAPTIVE) &&
+	    ring.spin_avg_nsec <= SPIN_USEC * 1000 / 2) {
+		fprintf(stderr, "late completions didn't raise the average: %u\n",
+			ring.spin_avg_nsec);
+		return 1;
+	}
+	for (i = 0; i < 4; i++) {
+		if (wait_timeout(&ring, 50000, 3))
+			return 1;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+
+static int test_invalid(void)
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(8, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_set_spin_wait(&ring, SPIN_USEC, 1U << 31);
+	if (ret != -EINVAL) {
+		fprintf(stderr, "unknown flag: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_set_spin_wait(&ring, 2000000, 0);
+	if (ret != -EINVAL) {
+		fprintf(stderr, "budget over a second: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_set_spin_wait(&ring, 0, 0);
+	if (ret) {
+		fprintf(stderr, "turning spin off: %d\n", ret);
+		return 1;
+	}
+	io_uring_queue_exit(&ring);
+
+	ret = io_uring_queue_init(8, &ring, IORING_SETUP_SINGLE_ISSUER |
+					    IORING_SETUP_DEFER_TASKRUN);
+	if (ret == -EINVAL)
+		return 0;
+	if (ret) {
+		fprintf(stderr, "defer taskrun ring setup failed: %d\n", ret);
+		return 1;
+	}
+	ret = io_uring_set_spin_wait(&ring, SPIN_USEC, 0);
+	if (ret != -EINVAL) {
+		fprintf(stderr, "spin on defer taskrun ring: %d\n", ret);
+		return 1;
+	}
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	ret = test_invalid();
+	if (ret) {
+		fprintf(stderr, "test_invalid failed\n");
+		return ret;
+	}
+
+	ret = test_spin(0);
+	if (ret) {
+		fprintf(stderr, "test_spin failed\n");
+		return ret;
+	}
+
+	ret = test_spin(LIBURING_SPIN_ADAPTIVE);
+	if (ret) {
+		fprintf(stderr, "test_spin adaptive failed\n");
+		return ret;
+	}
+
+	ret = test_spin(LIBURING_SPIN_YIELD);
+	if (ret) {
+		fprintf(stderr, "test_spin yield failed\n");
+		return ret;
+	}
+
+	return 0;
+}
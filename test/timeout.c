@@ -232,6 +232,44 @@ err:
 	return 1;
 }
 
+/*
+ * Test that a timed wait on kernels with IORING_FEAT_EXT_ARG doesn't consume
+ * an sqe, and still returns -ETIME when nothing completes
+ */
+static int test_single_timeout_wait_ext_arg(struct io_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+	struct __kernel_timespec ts;
+	unsigned long long exp;
+	struct timeval tv;
+	unsigned tail;
+	int ret;
+
+	if (!(ring->features & IORING_FEAT_EXT_ARG))
+		return 0;
+
+	tail = *ring->sq.ktail;
+	msec_to_ts(&ts, TIMEOUT_MSEC);
+
+	gettimeofday(&tv, NULL);
+	ret = io_uring_wait_cqe_timeout(ring, &cqe, &ts);
+	if (ret != -ETIME) {
+		fprintf(stderr, "%s: wait timeout got %d\n", __FUNCTION__, ret);
+		goto err;
+	}
+	if (*ring->sq.ktail != tail) {
+		fprintf(stderr, "%s: timed wait consumed an sqe\n", __FUNCTION__);
+		goto err;
+	}
+
+	exp = mtime_since_now(&tv);
+	if (exp >= TIMEOUT_MSEC / 2 && exp <= (TIMEOUT_MSEC * 3) / 2)
+		return 0;
+	fprintf(stderr, "%s: Timeout seems wonky (got %llu)\n", __FUNCTION__, exp);
+err:
+	return 1;
+}
+
 /*
  * Test single timeout waking us up
  */
@@ -1051,6 +1089,12 @@ int main(int argc, char *argv[])
 		return ret;
 	}
 
+	ret = test_single_timeout_wait_ext_arg(&ring);
+	if (ret) {
+		fprintf(stderr, "test_single_timeout_wait_ext_arg failed\n");
+		return ret;
+	}
+
 	/*
 	 * this test must go last, it kills the ring
 	 */
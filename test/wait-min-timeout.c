@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Description: test waiting for a batch of cqes with a minimum wait time,
+ *		after which any available cqe ends the wait
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "liburing.h"
+
+#define WAIT_NR		8
+#define MIN_WAIT_USEC	10000
+
+static unsigned long long mtime_since(const struct timeval *s,
+				      const struct timeval *e)
+{
+	long long sec, usec;
+
+	sec = e->tv_sec - s->tv_sec;
+	usec = (e->tv_usec - s->tv_usec);
+	if (sec > 0 && usec < 0) {
+		sec--;
+		usec += 1000000;
+	}
+
+	sec *= 1000;
+	usec /= 1000;
+	return sec + usec;
+}
+
+static unsigned long long mtime_since_now(struct timeval *tv)
+{
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	return mtime_since(tv, &end);
+}
+
+static void reap(struct io_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+
+	while (!io_uring_peek_cqe(ring, &cqe))
+		io_uring_cqe_seen(ring, cqe);
+}
+
+/*
+ * A single completion is handed back once the min wait expires, rather than
+ * after the full timeout waiting for WAIT_NR
+ */
+static int test_min_wait_one(struct io_uring *ring)
+{
+	struct __kernel_timespec ts = { .tv_sec = 1, };
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	unsigned long long msec;
+	struct timeval tv;
+	int ret;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_nop(sqe);
+	sqe->user_data = 1;
+
+	gettimeofday(&tv, NULL);
+	ret = io_uring_wait_cqes_min_timeout(ring, &cqe, WAIT_NR, &ts,
+					     MIN_WAIT_USEC, NULL);
+	msec = mtime_since_now(&tv);
+	if (ret) {
+		fprintf(stderr, "wait: %d\n", ret);
+		return 1;
+	}
+	if (cqe->user_data != 1) {
+		fprintf(stderr, "bad cqe %llu\n",
+			(unsigned long long) cqe->user_data);
+		return 1;
+	}
+	if (msec >= 500) {
+		fprintf(stderr, "min wait took %llu msec\n", msec);
+		return 1;
+	}
+	reap(ring);
+	return 0;
+}
+
+/*
+ * With nothing completed when the min wait expires, the first completion
+ * after it ends the wait
+ */
+static int test_min_wait_late(struct io_uring *ring)
+{
+	struct __kernel_timespec ts = { .tv_sec = 1, };
+	struct __kernel_timespec late = { .tv_nsec = 50000000, };
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	unsigned long long msec;
+	struct timeval tv;
+	int ret;
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_timeout(sqe, &late, 0, 0);
+	sqe->user_data = 2;
+
+	gettimeofday(&tv, NULL);
+	ret = io_uring_wait_cqes_min_timeout(ring, &cqe, WAIT_NR, &ts,
+					     MIN_WAIT_USEC, NULL);
+	msec = mtime_since_now(&tv);
+	if (ret) {
+		fprintf(stderr, "wait: %d\n", ret);
+		return 1;
+	}
+	if (cqe->user_data != 2 || cqe->res != -ETIME) {
+		fprintf(stderr, "bad cqe %llu res %d\n",
+			(unsigned long long) cqe->user_data, cqe->res);
+		return 1;
+	}
+	if (msec < 40 || msec >= 500) {
+		fprintf(stderr, "late completion took %llu msec\n", msec);
+		return 1;
+	}
+	reap(ring);
+	return 0;
+}
+
+/*
+ * Without any completion the overall timeout still applies
+ */
+static int test_min_wait_none(struct io_uring *ring)
+{
+	struct __kernel_timespec ts = { .tv_nsec = 20000000, };
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	ret = io_uring_wait_cqes_min_timeout(ring, &cqe, WAIT_NR, &ts,
+					     MIN_WAIT_USEC, NULL);
+	if (ret != -ETIME) {
+		fprintf(stderr, "wait without completions: %d\n", ret);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * A full batch doesn't wait for the min wait
+ */
+static int test_min_wait_full(struct io_uring *ring)
+{
+	struct __kernel_timespec ts = { .tv_sec = 1, };
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	int ret, i;
+
+	for (i = 0; i < WAIT_NR; i++) {
+		sqe = io_uring_get_sqe(ring);
+		io_uring_prep_nop(sqe);
+	}
+
+	ret = io_uring_wait_cqes_min_timeout(ring, &cqe, WAIT_NR, &ts,
+					     MIN_WAIT_USEC, NULL);
+	if (ret) {
+		fprintf(stderr, "wait: %d\n", ret);
+		return 1;
+	}
+	if (io_uring_cq_ready(ring) < WAIT_NR) {
+		fprintf(stderr, "got %u cqes\n", io_uring_cq_ready(ring));
+		return 1;
+	}
+	reap(ring);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring ring;
+	int ret;
+
+	ret = io_uring_queue_init(16, &ring, 0);
+	if (ret) {
+		fprintf(stderr, "ring setup failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = test_min_wait_full(&ring);
+	if (ret) {
+		fprintf(stderr, "test_min_wait_full failed\n");
+		return ret;
+	}
+
+	if (!(ring.features & IORING_FEAT_MIN_TIMEOUT)) {
+		fprintf(stdout, "Min wait timeout not supported, skipping\n");
+		return 0;
+	}
+
+	ret = test_min_wait_one(&ring);
+	if (ret) {
+		fprintf(stderr, "test_min_wait_one failed\n");
+		return ret;
+	}
+
+	ret = test_min_wait_late(&ring);
+	if (ret) {
+		fprintf(stderr, "test_min_wait_late failed\n");
+		return ret;
+	}
+
+	ret = test_min_wait_none(&ring);
+	if (ret) {
+		fprintf(stderr, "test_min_wait_none failed\n");
+		return ret;
+	}
+
+	io_uring_queue_exit(&ring);
+	return 0;
+}